@@ -0,0 +1,385 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <algorithm>
+#include <new>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+#include "can_filter_model.h"
+#include "can_manager.h"
+#include "inventory.h"
+#include "inventory_generator.h"
+#include "json_manager.h"
+#include "snapshot_manager.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// Allocation counting.
+/// With glibc, malloc itself is replaced, which also catches Qt's containers
+/// (they don't go through operator new). Elsewhere only operator new is
+/// counted.
+///////////////////////////////////////////////////////////////////////////////
+static std::atomic<quint64> Allocations(0);
+
+#if defined(__GLIBC__)
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* data, size_t size);
+extern "C" void __libc_free(void* data);
+
+extern "C" void* malloc(size_t size)
+{
+  ++Allocations;
+  return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+  ++Allocations;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* data, size_t size)
+{
+  ++Allocations;
+  return __libc_realloc(data, size);
+}
+
+extern "C" void free(void* data)
+{
+  __libc_free(data);
+}
+#else
+void* operator new(size_t size)
+{
+  ++Allocations;
+
+  void* data = malloc(size ? size : 1);
+
+  if(!data)
+    throw std::bad_alloc();
+
+  return data;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* data) noexcept
+{
+  free(data);
+}
+
+void operator delete[](void* data) noexcept
+{
+  free(data);
+}
+#endif
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// The managers for one run.
+///////////////////////////////////////////////////////////////////////////////
+class Fixture
+{
+  public:
+    Fixture() : cans(&goods, &dates) {}
+
+    GoodManager goods;
+    DateManager dates;
+    CanManager cans;
+
+  private:
+    Fixture(const Fixture&);
+    Fixture& operator=(const Fixture&);
+};
+
+static quint32 Seed = 1;
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns a pseudo-random number in [0, bound). Runs are reproducible.
+///////////////////////////////////////////////////////////////////////////////
+static int Random(int bound)
+{
+  Seed = Seed * 1103515245 + 12345;
+  return static_cast<int>((Seed >> 8) % static_cast<quint32>(bound));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns count random ids of cans in fixture, without repeats.
+///////////////////////////////////////////////////////////////////////////////
+static QList<int> RandomCans(const Fixture& fixture, int count)
+{
+  QList<int> can_ids = fixture.cans.goodIds().keys();
+  std::sort(can_ids.begin(), can_ids.end()); // Hash order varies by run.
+
+  for(int i = 0; i < count && i < can_ids.size(); ++i)
+    can_ids.swap(i, i + Random(can_ids.size() - i));
+
+  return can_ids.mid(0, count);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Runs function, which performs ops operations on can_count cans, and
+/// prints the time and allocations per operation.
+///////////////////////////////////////////////////////////////////////////////
+template<typename Function>
+static void Measure(const char* operation,
+                    int can_count,
+                    int ops,
+                    Function function)
+{
+  QElapsedTimer timer;
+  quint64 allocations = Allocations;
+
+  timer.start();
+  function();
+  qint64 nsecs = timer.nsecsElapsed();
+
+  allocations = Allocations - allocations;
+
+  printf("%-18s %9d %8d %14.1f %12.2f\n",
+         operation,
+         can_count,
+         ops,
+         static_cast<double>(nsecs) / ops,
+         static_cast<double>(allocations) / ops);
+  fflush(stdout);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Runs every benchmark against can_count generated cans, writing files to
+/// directory. The inventory is the generator's default shape with a fixed
+/// seed, so runs at the same size are comparable. Edits are timed over at
+/// most a thousand operations, so the figures are per operation at that
+/// inventory size.
+///////////////////////////////////////////////////////////////////////////////
+static void Run(int can_count, const QString& directory)
+{
+  const int ops = qMin(can_count, 1000);
+  const int good_count = qMax(10, can_count / 100);
+
+  InventoryGenerator generator;
+  generator.setCanCount(can_count);
+  generator.setGoodCount(good_count);
+
+  Fixture fixture;
+  generator.generate(&fixture.goods, &fixture.dates, &fixture.cans);
+
+  QList<int> date_ids = fixture.dates.dates().keys();
+  std::sort(date_ids.begin(), date_ids.end());
+
+  // A random date that's already in use.
+  auto RandomDate = [&]() -> int64_t {
+    return fixture.dates.date(date_ids.at(Random(date_ids.size())));
+  };
+
+  Measure("expiringWithin", can_count, ops, [&]() {
+    for(int i = 0; i < ops; ++i)
+      fixture.cans.expiringWithin(Random(3 * 365));
+  });
+
+  Measure("sort", can_count, 1, [&]() {
+    fixture.cans.sort();
+  });
+
+  {
+    CanFilterModel filter(&fixture.cans, &fixture.goods, &fixture.dates);
+    QString good = InventoryGenerator::GoodName(Random(good_count));
+
+    // Types a good's name into the search box, then deletes it.
+    Measure("filter keystroke", can_count, 2 * good.size(), [&]() {
+      for(int i = 1; i <= good.size(); ++i)
+        filter.setGoodFilter(good.left(i));
+
+      for(int i = good.size() - 1; i >= 0; --i)
+        filter.setGoodFilter(good.left(i));
+    });
+  }
+
+  Measure("add", can_count, ops, [&]() {
+    for(int i = 0; i < ops; ++i) {
+      QString good = InventoryGenerator::GoodName(Random(good_count));
+      fixture.cans.add(good, RandomDate());
+    }
+  });
+
+  Measure("insert", can_count, ops, [&]() {
+    for(int i = 0; i < ops; ++i)
+      fixture.cans.insert(fixture.cans.nextId(0),
+                          1 + Random(good_count),
+                          date_ids.at(Random(date_ids.size())));
+  });
+
+  QList<int> lot_ids;
+  lot_ids.reserve(ops);
+
+  // A case of 24 is one row.
+  Measure("add lot", can_count, ops, [&]() {
+    for(int i = 0; i < ops; ++i) {
+      QString good = InventoryGenerator::GoodName(Random(good_count));
+      int can_id = 0;
+
+      fixture.cans.add(good, RandomDate(), &can_id, 24);
+      lot_ids.append(can_id);
+    }
+  });
+
+  Measure("take from lot", can_count, lot_ids.size(), [&]() {
+    for(int i = 0; i < lot_ids.size(); ++i)
+      fixture.cans.setQuantity(lot_ids.at(i),
+                               fixture.cans.quantity(lot_ids.at(i)) - 1);
+  });
+
+  QList<int> can_ids = RandomCans(fixture, ops);
+
+  Measure("bulk edit goods", can_count, can_ids.size(), [&]() {
+    fixture.cans.editGoods(can_ids,
+                           InventoryGenerator::GoodName(Random(good_count)));
+  });
+
+  Measure("bulk edit dates", can_count, can_ids.size(), [&]() {
+    fixture.cans.editDates(can_ids, RandomDate());
+  });
+
+  can_ids = RandomCans(fixture, ops);
+
+  Measure("remove", can_count, can_ids.size(), [&]() {
+    for(int i = 0; i < can_ids.size(); ++i)
+      fixture.cans.remove(can_ids.at(i));
+  });
+
+  const int good_id = 1 + Random(good_count);
+  const int good_cans = fixture.cans.goodRefCount(good_id);
+
+  Measure("remove by good", can_count, qMax(good_cans, 1), [&]() {
+    fixture.cans.removeByGood(good_id);
+  });
+
+  QString json_file_name = directory + "/can_data.json";
+  QString json_v3_file_name = directory + "/can_data_v3.json";
+  QString snapshot_file_name = directory + "/can_data.snapshot";
+
+  Measure("save json", can_count, 1, [&]() {
+    JsonManager::Write(json_file_name,
+                       Inventory(&fixture.goods,
+                                 &fixture.dates,
+                                 &fixture.cans));
+  });
+
+  Measure("save snapshot", can_count, 1, [&]() {
+    SnapshotManager::Write(snapshot_file_name,
+                           Inventory(&fixture.goods,
+                                     &fixture.dates,
+                                     &fixture.cans),
+                           0,
+                           0);
+  });
+
+  {
+    Fixture loaded;
+    JsonManager json(json_file_name,
+                     &loaded.goods,
+                     &loaded.dates,
+                     &loaded.cans);
+
+    Measure("load json", can_count, 1, [&]() {
+      json.read();
+    });
+  }
+
+  // The generator writes in id order rather than row order, and v3 so the
+  // lots added above survive.
+  {
+    QFile file(json_v3_file_name);
+
+    if(file.open(QFile::WriteOnly))
+      file.write(generator.json(Inventory(&fixture.goods,
+                                          &fixture.dates,
+                                          &fixture.cans),
+                                3,
+                                InventoryGenerator::NoDamage));
+  }
+
+  {
+    Fixture loaded;
+    JsonManager json(json_v3_file_name,
+                     &loaded.goods,
+                     &loaded.dates,
+                     &loaded.cans);
+
+    Measure("load json v3", can_count, 1, [&]() {
+      json.read();
+    });
+  }
+
+  {
+    Fixture loaded;
+    SnapshotManager snapshot(snapshot_file_name,
+                             &loaded.goods,
+                             &loaded.dates,
+                             &loaded.cans);
+
+    Measure("load snapshot", can_count, 1, [&]() {
+      snapshot.read();
+    });
+  }
+
+  // Last, since it removes a good part of the inventory.
+  const int64_t purge_day = RandomDate();
+  const int expired_cans = fixture.cans.expiringOnOrBefore(purge_day - 1);
+
+  Measure("remove expired", can_count, qMax(expired_cans, 1), [&]() {
+    fixture.cans.removeExpiredBefore(purge_day);
+  });
+}
+
+} // namespace jccu
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Program entry point.
+/// Usage: jccu-bench [max cans]
+/// Runs at 1k, 10k, 100k and 1M cans, stopping after max cans (default 1M).
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+  QCoreApplication app(argc, argv);
+  QStringList arguments = app.arguments();
+
+  int max_cans = 1000000;
+
+  if(arguments.size() > 1)
+    max_cans = arguments.at(1).toInt();
+
+  QTemporaryDir directory;
+
+  if(!directory.isValid()) {
+    fprintf(stderr, "Can't create a temporary directory.\n");
+    return 1;
+  }
+
+  printf("%-18s %9s %8s %14s %12s\n",
+         "operation", "cans", "ops", "ns/op", "allocs/op");
+
+  for(int can_count = 1000; can_count <= max_cans; can_count *= 10)
+    jccu::Run(can_count, directory.path());
+
+  return 0;
+}
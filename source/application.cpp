@@ -3,12 +3,25 @@
 //////////////////////////////////////////////////////////////////////////////
 #include "application.h"
 
+#include <QAbstractItemModel>
 #include <QApplication>
+#include <QDateTime>
 #include <QFile>
+#include <QMessageBox>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QThreadPool>
 #include <QTimer>
+#include <QVector>
 #include "can_manager.h"
+#include "journal_manager.h"
 #include "json_manager.h"
+#include "load_task.h"
+#include "metrics.h"
+#include "save_task.h"
+#include "snapshot_manager.h"
 #include "system_tray_icon.h"
+#include "trace.h"
 #include "window.h"
 
 namespace jccu
@@ -25,8 +38,18 @@ Application::Application()
     dates_(nullptr),
     cans_(nullptr),
     json_(nullptr),
+    snapshot_(nullptr),
+    journal_(nullptr),
+    load_task_(nullptr),
     icon_(nullptr),
-    window_(nullptr)
+    window_(nullptr),
+    save_pool_(nullptr),
+    autosave_timer_(nullptr),
+    generation_(0),
+    dirty_(false),
+    save_pending_(false),
+    last_save_ok_(true),
+    load_failed_(false)
 {
 }
 
@@ -36,22 +59,55 @@ Application::Application()
 //////////////////////////////////////////////////////////////////////////////
 Application::~Application()
 {
+  // Stops the managers recording, so it has to go first.
+  delete journal_;
+
+  delete load_task_;
   delete goods_;
   delete dates_;
   delete cans_;
   delete json_;
+  delete snapshot_;
 }
 
 
 //////////////////////////////////////////////////////////////////////////////
 /// Runs the application and returns the exit code once finished.
+/// With --trace <file>, spans are recorded for the whole run and written to
+/// file on exit. With --metrics <file>, the metrics are written to file on
+/// exit.
 //////////////////////////////////////////////////////////////////////////////
 int Application::run(int argc, char** argv)
 {
   QApplication qapp(argc, argv);
 
+  QStringList arguments = qapp.arguments();
+
+  // Returns the argument after option, or an empty string.
+  auto Option = [&arguments](const QString& option) -> QString {
+    int index = arguments.indexOf(option);
+
+    if(index < 0 || index + 1 >= arguments.size())
+      return QString();
+
+    return arguments.at(index + 1);
+  };
+
+  QString trace_file_name = Option("--trace");
+  QString metrics_file_name = Option("--metrics");
+
+  if(!trace_file_name.isEmpty())
+    Tracer::Start(trace_file_name);
+
   QTimer::singleShot(0, this, SLOT(load()));
-  return qapp.exec();
+  int code = qapp.exec();
+
+  Tracer::Stop();
+
+  if(!metrics_file_name.isEmpty())
+    Metrics::Write(metrics_file_name);
+
+  return code;
 }
 
 
@@ -119,18 +175,33 @@ void Application::load()
   cans_  = new CanManager(goods_, dates_);
 
   json_ = new JsonManager("can_data.json", goods_, dates_, cans_);
-  json_->read();
+  snapshot_ = new SnapshotManager("can_data.snapshot", goods_, dates_, cans_);
+  journal_ = new JournalManager("can_data.journal", goods_, dates_, cans_);
 
   icon_ = new SystemTrayIcon(this);
 
+  // The window comes up empty and is filled in by loadFinished.
   window_ = new Window;
+  window_->setLoading(true);
   window_->show();
 
   auto expiration_timer = new QTimer(this);
   expiration_timer->setObjectName("expirationTimer");
   expiration_timer->setInterval(1000 * 60 * 60 * 24); // 1 day.
   expiration_timer->start();
-  on_expirationTimer_timeout(); // Manual invoke on application startup.
+
+  // Loads and saves run one at a time, off the gui thread.
+  save_pool_ = new QThreadPool(this);
+  save_pool_->setMaxThreadCount(1);
+
+  autosave_timer_ = new QTimer(this);
+  autosave_timer_->setObjectName("autosaveTimer");
+  autosave_timer_->setInterval(1000 * 5); // 5 seconds after the last edit.
+  autosave_timer_->setSingleShot(true);
+
+  load_task_ = new LoadTask(json_->fileName(), snapshot_->fileName(),
+                            journal_->fileName(), this);
+  save_pool_->start(load_task_);
 
   qApp->setQuitOnLastWindowClosed(false);
 
@@ -144,11 +215,161 @@ void Application::load()
 
 
 ///////////////////////////////////////////////////////////////////////////////
-/// Saves the application data.
+/// Takes over what the load task read and starts recording changes.
+/// Each manager is swapped in with a single reset. A journal replayed on top
+/// of what was read is carried on with; otherwise a new journal is started
+/// and a snapshot for it is saved straight away. If nothing could be read,
+/// the user is told and the files are left as they are: the journal isn't
+/// started over and nothing is saved.
+///////////////////////////////////////////////////////////////////////////////
+void Application::loadFinished(bool ok)
+{
+  JCCU_TRACE("Application::loadFinished");
+
+  QScopedPointer<LoadTask> task(load_task_);
+  load_task_ = nullptr;
+
+  goods_->swap(task->goodManager());
+  dates_->swap(task->dateManager());
+  cans_->swap(task->canManager());
+
+  window_->setLoading(false);
+
+  if(!ok) {
+    load_failed_ = true;
+
+    QMessageBox::warning(window_, "jccu",
+      QString("The inventory couldn't be read from %1, %2 or %3. The files "
+              "are left as they are, and changes won't be saved until "
+              "jccu is restarted with readable files.")
+        .arg(json_->fileName())
+        .arg(snapshot_->fileName())
+        .arg(journal_->fileName()));
+
+    return;
+  }
+
+  // The task already replayed the journal, so it's only reopened here.
+  if(journal_->resume(task->replayedSize())) {
+    // The snapshot on disk may predate the resumed journal, so the next save
+    // mustn't rotate it away.
+    generation_ = journal_->generation();
+    last_save_ok_ = false;
+  }
+  else {
+    generation_ = qMax<quint64>(task->generation() + 1,
+                                QDateTime::currentMSecsSinceEpoch());
+    journal_->open(generation_);
+
+    save_pending_ = true;
+    save_pool_->start(prepareSave(false, this));
+  }
+
+  watch(goods_);
+  watch(dates_);
+  watch(cans_);
+
+  on_expirationTimer_timeout(); // Manual invoke once the cans are in.
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Saves the application data before quitting.
+/// Waits for any background load or save, then saves on this thread if
+/// anything might not have reached the disk.
 ///////////////////////////////////////////////////////////////////////////////
 void Application::save()
 {
-  json_->write();
+  JCCU_TRACE("Application::save");
+
+  autosave_timer_->stop();
+  save_pool_->waitForDone();
+
+  // Quit before the load was taken over; the managers are still empty.
+  // After a failed load they'd overwrite the files that couldn't be read.
+  if(load_task_ || load_failed_)
+    return;
+
+  // A finished background save hasn't reported back yet, so its result is
+  // unknown; the journal isn't rotated in case it failed.
+  if(!dirty_ && !save_pending_ && last_save_ok_)
+    return;
+
+  QScopedPointer<SaveTask> task(prepareSave(false, nullptr));
+  task->save();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records the result of a background save.
+/// A failed save is retried after the usual delay.
+///////////////////////////////////////////////////////////////////////////////
+void Application::saveFinished(bool ok)
+{
+  save_pending_ = false;
+  last_save_ok_ = ok;
+
+  if(!ok) {
+    dirty_ = true;
+    autosave_timer_->start();
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Schedules an autosave whenever model changes. Changes to the foreground
+/// role alone are the expiration colours being repainted at midnight, so
+/// there's nothing new to save.
+///////////////////////////////////////////////////////////////////////////////
+void Application::watch(QAbstractItemModel* model)
+{
+  auto Schedule = [this]() {
+    dirty_ = true;
+    autosave_timer_->start();
+  };
+
+  auto ScheduleData = [Schedule](const QModelIndex&,
+                                 const QModelIndex&,
+                                 const QVector<int>& roles) {
+    if(roles.isEmpty() || roles.count(Qt::ForegroundRole) != roles.size())
+      Schedule();
+  };
+
+  connect(model, &QAbstractItemModel::dataChanged, this, ScheduleData);
+  connect(model, &QAbstractItemModel::layoutChanged, this, Schedule);
+  connect(model, &QAbstractItemModel::modelReset, this, Schedule);
+  connect(model, &QAbstractItemModel::rowsInserted, this, Schedule);
+  connect(model, &QAbstractItemModel::rowsMoved, this, Schedule);
+  connect(model, &QAbstractItemModel::rowsRemoved, this, Schedule);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Captures the managers for a save and returns the task that writes it.
+/// If rotate_journal, the capture starts a new journal generation; the
+/// snapshot names the journal and offset its changes continue from either
+/// way. The task reports back to receiver, if it's non-null.
+///////////////////////////////////////////////////////////////////////////////
+SaveTask* Application::prepareSave(bool rotate_journal, QObject* receiver)
+{
+  JCCU_TRACE("Application::prepareSave");
+
+  if(rotate_journal) {
+    quint64 generation = qMax<quint64>(generation_ + 1,
+                                       QDateTime::currentMSecsSinceEpoch());
+
+    if(journal_->rotate(generation))
+      generation_ = generation;
+  }
+
+  dirty_ = false;
+
+  return new SaveTask(Inventory(goods_, dates_, cans_),
+                      json_->fileName(),
+                      snapshot_->fileName(),
+                      journal_->generation(),
+                      journal_->size(),
+                      receiver);
 }
 
 
@@ -166,11 +387,35 @@ void Application::on_systemTrayIcon_doubleClicked()
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+/// Starts a background save once edits have settled.
+/// Only one save runs at a time; edits made meanwhile wait for the next.
+//////////////////////////////////////////////////////////////////////////////
+void Application::on_autosaveTimer_timeout()
+{
+  JCCU_TRACE("Application::on_autosaveTimer_timeout");
+
+  if(!dirty_)
+    return;
+
+  if(save_pending_) {
+    autosave_timer_->start();
+    return;
+  }
+
+  // Only rotate once the last snapshot is known to be on disk.
+  save_pending_ = true;
+  save_pool_->start(prepareSave(last_save_ok_, this));
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 /// Pops a system tray icon warning if any cans are expiring soon.
 //////////////////////////////////////////////////////////////////////////////
 void Application::on_expirationTimer_timeout()
 {
+  JCCU_TRACE("Application::on_expirationTimer_timeout");
+
   int expired_count = cans_->expiringWithin(0);
   int expiring_count = cans_->expiringWithin(7) - expired_count;
 
@@ -7,6 +7,10 @@
 #include <QObject>
 #include <QString>
 
+class QAbstractItemModel;
+class QThreadPool;
+class QTimer;
+
 namespace jccu
 {
 
@@ -14,6 +18,10 @@ class GoodManager;
 class DateManager;
 class CanManager;
 class JsonManager;
+class JournalManager;
+class LoadTask;
+class SnapshotManager;
+class SaveTask;
 class SystemTrayIcon;
 class Window;
 
@@ -41,21 +49,38 @@ class Application : public QObject
     Application(const Application&);
     Application& operator=(const Application&);
 
+    void watch(QAbstractItemModel* model);
+    SaveTask* prepareSave(bool rotate_journal, QObject* receiver);
+
     GoodManager* goods_;
     DateManager* dates_;
     CanManager* cans_;
     JsonManager* json_;
+    SnapshotManager* snapshot_;
+    JournalManager* journal_;
+    LoadTask* load_task_;
     SystemTrayIcon* icon_;
     Window* window_;
+    QThreadPool* save_pool_;
+    QTimer* autosave_timer_;
+
+    quint64 generation_;
+    bool dirty_;
+    bool save_pending_;
+    bool last_save_ok_;
+    bool load_failed_; // Nothing is saved, so the files can be recovered.
 
     static Application* Instance_;
 
   private slots:
     void load();
+    void loadFinished(bool ok);
     void save();
+    void saveFinished(bool ok);
 
     void on_systemTrayIcon_doubleClicked();
     void on_expirationTimer_timeout();
+    void on_autosaveTimer_timeout();
 };
 
 } // namespace jccu
@@ -0,0 +1,743 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "can_filter_model.h"
+
+#include <algorithm>
+#include <limits>
+#include "can_manager.h"
+#include "date_manager.h"
+#include "good_manager.h"
+#include "trace.h"
+
+namespace jccu
+{
+
+const int CanFilterModel::MaxRuns = 32;
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor. Nothing is filtered to begin with.
+///////////////////////////////////////////////////////////////////////////////
+CanFilterModel::CanFilterModel(CanManager* can_manager,
+                               GoodManager* good_manager,
+                               DateManager* date_manager,
+                               QObject* parent)
+  : QAbstractProxyModel(parent),
+    cans_(can_manager),
+    goods_(good_manager),
+    dates_(date_manager),
+    first_day_(std::numeric_limits<int64_t>::min()),
+    last_day_(std::numeric_limits<int64_t>::max()),
+    band_(AnyBand)
+{
+  QAbstractProxyModel::setSourceModel(cans_);
+
+  rows_list_ = matchingRows();
+
+  connect(cans_, &CanManager::rowsInserted, this,
+          [this](const QModelIndex&, int first, int last) {
+    sourceRowsInserted(first, last);
+  });
+
+  connect(cans_, &CanManager::rowsAboutToBeRemoved, this,
+          [this](const QModelIndex&, int first, int last) {
+    sourceRowsAboutToBeRemoved(first, last);
+  });
+
+  connect(cans_, &CanManager::rowsRemoved, this,
+          [this](const QModelIndex&, int first, int last) {
+    sourceRowsRemoved(first, last);
+  });
+
+  connect(cans_, &CanManager::rowsMoved, this,
+          [this](const QModelIndex&, int first, int last,
+                 const QModelIndex&, int destination) {
+    sourceRowsMoved(first, last, destination);
+  });
+
+  connect(cans_, &CanManager::dataChanged, this,
+          [this](const QModelIndex& top_left,
+                 const QModelIndex& bottom_right,
+                 const QVector<int>& roles) {
+    sourceDataChanged(top_left, bottom_right, roles);
+  });
+
+  connect(cans_, &CanManager::layoutAboutToBeChanged, this,
+          [this]() { sourceLayoutAboutToBeChanged(); });
+  connect(cans_, &CanManager::layoutChanged, this,
+          [this]() { sourceLayoutChanged(); });
+  connect(cans_, &CanManager::modelAboutToBeReset, this,
+          [this]() { sourceAboutToBeReset(); });
+  connect(cans_, &CanManager::modelReset, this,
+          [this]() { sourceReset(); });
+
+  // Goods added or removed may change what the good filter matches.
+  auto RefreshGoods = [this]() {
+    if(!good_query_.isEmpty())
+      setGoodFilter(good_query_);
+  };
+
+  connect(goods_, &GoodManager::rowsInserted, this, RefreshGoods);
+  connect(goods_, &GoodManager::rowsRemoved, this, RefreshGoods);
+  connect(goods_, &GoodManager::modelReset, this, RefreshGoods);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+CanFilterModel::~CanFilterModel()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Shows only cans whose good matches query, as ranked by
+/// GoodManager::search. An empty query shows cans of every good.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::setGoodFilter(const QString& query)
+{
+  JCCU_TRACE("CanFilterModel::setGoodFilter");
+
+  QString good_query = query.simplified();
+  QSet<int> goods_set;
+
+  if(!good_query.isEmpty()) {
+    QList<int> good_ids = goods_->search(good_query, goods_->rowCount());
+
+    for(int i = 0; i < good_ids.size(); ++i)
+      goods_set.insert(good_ids.at(i));
+  }
+
+  // Typing more usually matches fewer goods; then only the rows already
+  // shown need checking.
+  bool narrowing = !good_query.isEmpty();
+
+  if(narrowing && !good_query_.isEmpty()) {
+    auto it = goods_set.constBegin(),
+         end = goods_set.constEnd();
+
+    for(; it != end && narrowing; ++it)
+      narrowing = goods_set_.contains(*it);
+  }
+
+  good_query_ = good_query;
+  goods_set_ = goods_set;
+  refilter(narrowing);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Shows only cans expiring from first_day to last_day, inclusive (Julian
+/// days). Pass the int64_t limits to leave either end open.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::setExpiryRange(int64_t first_day, int64_t last_day)
+{
+  JCCU_TRACE("CanFilterModel::setExpiryRange");
+
+  if(first_day == first_day_ && last_day == last_day_)
+    return;
+
+  bool narrowing = first_day >= first_day_ && last_day <= last_day_;
+
+  first_day_ = first_day;
+  last_day_ = last_day;
+  refilter(narrowing);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Shows only cans in the given expiry band, relative to today.
+/// Combines with the expiry range.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::setExpiryBand(ExpiryBand band)
+{
+  JCCU_TRACE("CanFilterModel::setExpiryBand");
+
+  if(band == band_)
+    return;
+
+  bool narrowing = band_ == AnyBand ||
+                   (band_ == MonthBand && band == WeekBand);
+
+  band_ = band;
+  refilter(narrowing);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the index of the given can manager index, or an invalid index if
+/// it's filtered out.
+///////////////////////////////////////////////////////////////////////////////
+QModelIndex CanFilterModel::mapFromSource(
+  const QModelIndex& source_index) const
+{
+  if(!source_index.isValid())
+    return QModelIndex();
+
+  int row = proxyRow(source_index.row());
+
+  if(row >= rows_list_.size() || rows_list_.at(row) != source_index.row())
+    return QModelIndex();
+
+  return index(row, source_index.column());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the can manager index of the given index.
+///////////////////////////////////////////////////////////////////////////////
+QModelIndex CanFilterModel::mapToSource(const QModelIndex& proxy_index) const
+{
+  if(!proxy_index.isValid() || proxy_index.row() >= rows_list_.size())
+    return QModelIndex();
+
+  return cans_->index(rows_list_.at(proxy_index.row()),
+                      proxy_index.column());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the index at row and column. The model is a flat table.
+///////////////////////////////////////////////////////////////////////////////
+QModelIndex CanFilterModel::index(int row,
+                                  int column,
+                                  const QModelIndex& parent) const
+{
+  if(!hasIndex(row, column, parent))
+    return QModelIndex();
+
+  return createIndex(row, column);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns an invalid index; no index has a parent.
+///////////////////////////////////////////////////////////////////////////////
+QModelIndex CanFilterModel::parent(const QModelIndex& child) const
+{
+  return QModelIndex();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of columns.
+///////////////////////////////////////////////////////////////////////////////
+int CanFilterModel::columnCount(const QModelIndex& parent) const
+{
+  if(parent.isValid())
+    return 0;
+
+  return cans_->columnCount();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of cans shown.
+///////////////////////////////////////////////////////////////////////////////
+int CanFilterModel::rowCount(const QModelIndex& parent) const
+{
+  if(parent.isValid())
+    return 0;
+
+  return rows_list_.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Outputs the days cans have to expire within, inclusive: the expiry range
+/// narrowed by the expiry band. first_day > last_day if none can.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::expiryBounds(int64_t* first_day, int64_t* last_day) const
+{
+  const int64_t today = cans_->today();
+
+  *first_day = first_day_;
+  *last_day = last_day_;
+
+  switch(band_) {
+    case ExpiredBand:
+      *last_day = std::min(*last_day, today);
+      break;
+
+    case WeekBand:
+      *first_day = std::max(*first_day, today + 1);
+      *last_day = std::min(*last_day, today + 7);
+      break;
+
+    case MonthBand:
+      *first_day = std::max(*first_day, today + 1);
+      *last_day = std::min(*last_day, today + 30);
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if the can in source_row passes the filters, given the
+/// expiryBounds.
+///////////////////////////////////////////////////////////////////////////////
+bool CanFilterModel::accepts(int source_row,
+                             int64_t first_day,
+                             int64_t last_day) const
+{
+  int can_id = cans_->id(source_row);
+  int64_t date = dates_->date(cans_->dateIds().value(can_id));
+
+  if(date < first_day || date > last_day)
+    return false;
+
+  if(good_query_.isEmpty())
+    return true;
+
+  return goods_set_.contains(cans_->goodIds().value(can_id));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the source rows of every can that passes the filters, ascending.
+/// Only the rows within the expiry bounds are looked at, or only the cans of
+/// the matching goods if they're fewer.
+///////////////////////////////////////////////////////////////////////////////
+QVector<int> CanFilterModel::matchingRows() const
+{
+  int64_t first_day, last_day;
+  expiryBounds(&first_day, &last_day);
+
+  QVector<int> rows;
+  int first, end;
+  cans_->rowsExpiringBetween(first_day, last_day, &first, &end);
+
+  if(good_query_.isEmpty()) {
+    rows.reserve(std::max(end - first, 0));
+
+    for(int i = first; i < end; ++i)
+      rows.append(i);
+
+    return rows;
+  }
+
+  int can_count = 0;
+
+  auto good_it = goods_set_.constBegin(),
+       good_end = goods_set_.constEnd();
+
+  for(; good_it != good_end; ++good_it)
+    can_count += cans_->goodRefCount(*good_it);
+
+  // Gathering the rows of a few goods' cans and sorting them beats checking
+  // a long range of rows one by one.
+  if(can_count < (end - first) / 4) {
+    rows.reserve(can_count);
+
+    for(good_it = goods_set_.constBegin(); good_it != good_end; ++good_it) {
+      QSet<int> can_ids = cans_->goodCans(*good_it);
+
+      auto it = can_ids.constBegin(),
+           can_end = can_ids.constEnd();
+
+      for(; it != can_end; ++it) {
+        int row = cans_->row(*it);
+
+        if(row >= first && row < end)
+          rows.append(row);
+      }
+    }
+
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  }
+
+  const QHash<int, int>& good_ids = cans_->goodIds();
+  rows.reserve(std::max(end - first, 0));
+
+  for(int i = first; i < end; ++i)
+    if(goods_set_.contains(good_ids.value(cans_->id(i))))
+      rows.append(i);
+
+  return rows;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the first row showing source_row or a later source row, or the
+/// row count if there's none.
+///////////////////////////////////////////////////////////////////////////////
+int CanFilterModel::proxyRow(int source_row) const
+{
+  auto it = std::lower_bound(rows_list_.constBegin(), rows_list_.constEnd(),
+                             source_row);
+
+  return it - rows_list_.constBegin();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Applies changed filters. If narrowing, the filters can only have hidden
+/// cans, so only the rows already shown are checked.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::refilter(bool narrowing)
+{
+  JCCU_TRACE("CanFilterModel::refilter");
+
+  if(!cans_->rowCount())
+    return;
+
+  QVector<int> rows;
+
+  if(narrowing) {
+    int64_t first_day, last_day;
+    expiryBounds(&first_day, &last_day);
+
+    rows.reserve(rows_list_.size());
+
+    auto it = rows_list_.constBegin(),
+         end = rows_list_.constEnd();
+
+    for(; it != end; ++it)
+      if(accepts(*it, first_day, last_day))
+        rows.append(*it);
+  }
+  else {
+    rows = matchingRows();
+  }
+
+  replaceRows(0, cans_->rowCount() - 1, rows);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Re-checks the source rows from first to last.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::refilterRows(int first, int last)
+{
+  int64_t first_day, last_day;
+  expiryBounds(&first_day, &last_day);
+
+  QVector<int> rows;
+
+  for(int i = first; i <= last; ++i)
+    if(accepts(i, first_day, last_day))
+      rows.append(i);
+
+  replaceRows(first, last, rows);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Makes rows the shown source rows between first and last, inclusive.
+/// rows must be ascending and within first and last. Each run of rows that
+/// come or go is notified on its own; if there are too many runs, it's one
+/// layout change instead.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::replaceRows(int first, int last,
+                                 const QVector<int>& rows)
+{
+  const int begin = proxyRow(first);
+  const int end = proxyRow(last + 1);
+
+  enum {Kept, Removed, Inserted} state = Kept;
+  QVector<int> removed_rows; // <ProxyRow>, ascending.
+  int runs = 0;
+  int i = begin, j = 0;
+
+  while(i < end || j < rows.size()) {
+    if(i < end && j < rows.size() && rows_list_.at(i) == rows.at(j)) {
+      state = Kept;
+      ++i;
+      ++j;
+    }
+    else if(j == rows.size() || (i < end && rows_list_.at(i) < rows.at(j))) {
+      runs += (state != Removed);
+      state = Removed;
+      removed_rows.append(i);
+      ++i;
+    }
+    else {
+      runs += (state != Inserted);
+      state = Inserted;
+      ++j;
+    }
+  }
+
+  if(!runs)
+    return;
+
+  if(runs > MaxRuns) {
+    QVector<int> rows_list = rows_list_.mid(0, begin);
+    rows_list += rows;
+    rows_list += rows_list_.mid(end);
+    relayout(rows_list);
+    return;
+  }
+
+  int last_removed = removed_rows.size() - 1;
+
+  // Remove backwards so the rows still to be removed don't shift.
+  while(last_removed >= 0) {
+    int first_removed = last_removed;
+
+    while(first_removed > 0 &&
+          removed_rows.at(first_removed - 1) ==
+          removed_rows.at(first_removed) - 1)
+      --first_removed;
+
+    const int first_row = removed_rows.at(first_removed),
+              last_row = removed_rows.at(last_removed);
+
+    beginRemoveRows(QModelIndex(), first_row, last_row);
+      rows_list_.remove(first_row, last_row - first_row + 1);
+    endRemoveRows();
+
+    last_removed = first_removed - 1;
+  }
+
+  // What's left between begin and kept_end are rows that stay.
+  int kept_end = end - removed_rows.size();
+  int row = begin;
+  j = 0;
+
+  while(j < rows.size()) {
+    if(row < kept_end && rows_list_.at(row) == rows.at(j)) {
+      ++row;
+      ++j;
+      continue;
+    }
+
+    int first_inserted = j;
+
+    while(j < rows.size() &&
+          (row >= kept_end || rows.at(j) < rows_list_.at(row)))
+      ++j;
+
+    const int count = j - first_inserted;
+
+    beginInsertRows(QModelIndex(), row, row + count - 1);
+      rows_list_.insert(row, count, 0);
+      std::copy(rows.constBegin() + first_inserted, rows.constBegin() + j,
+                rows_list_.begin() + row);
+    endInsertRows();
+
+    row += count;
+    kept_end += count;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Makes rows the shown source rows in a single layout change. The source
+/// rows mustn't have moved since they were shown.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::relayout(const QVector<int>& rows)
+{
+  emit layoutAboutToBeChanged();
+  saveLayout();
+  rows_list_ = rows;
+  restoreLayout();
+  emit layoutChanged();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Remembers which can each persistent index (e.g. the view's selection)
+/// is on, ahead of a layout change.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::saveLayout()
+{
+  layout_indexes_ = persistentIndexList();
+  layout_can_ids_.clear();
+  layout_can_ids_.reserve(layout_indexes_.size());
+
+  auto it = layout_indexes_.constBegin(),
+       end = layout_indexes_.constEnd();
+
+  for(; it != end; ++it)
+    layout_can_ids_.append(cans_->id(rows_list_.at(it->row())));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Moves the persistent indexes saved by saveLayout to their cans' new rows.
+/// Indexes on cans that are no longer shown become invalid.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::restoreLayout()
+{
+  QModelIndexList new_indexes;
+  new_indexes.reserve(layout_indexes_.size());
+
+  for(int i = 0; i < layout_indexes_.size(); ++i) {
+    int can_id = layout_can_ids_.at(i);
+    QModelIndex new_index;
+
+    if(cans_->exists(can_id))
+      new_index = mapFromSource(cans_->index(cans_->row(can_id),
+                                             layout_indexes_.at(i).column()));
+
+    new_indexes.append(new_index);
+  }
+
+  changePersistentIndexList(layout_indexes_, new_indexes);
+  layout_indexes_.clear();
+  layout_can_ids_.clear();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Shifts the rows after the inserted ones and shows those that pass.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::sourceRowsInserted(int first, int last)
+{
+  const int count = last - first + 1;
+
+  for(int i = proxyRow(first); i < rows_list_.size(); ++i)
+    rows_list_[i] += count;
+
+  refilterRows(first, last);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Removes the rows about to be removed while they still have their cans.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::sourceRowsAboutToBeRemoved(int first, int last)
+{
+  replaceRows(first, last, QVector<int>());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Shifts the rows after the removed ones.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::sourceRowsRemoved(int first, int last)
+{
+  const int count = last - first + 1;
+
+  for(int i = proxyRow(first); i < rows_list_.size(); ++i)
+    rows_list_[i] -= count;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Follows source rows first to last to before destination, which is given
+/// in terms of the rows before the move. Moving a shown row moves its row
+/// here too, so the view's selection stays on it.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::sourceRowsMoved(int first, int last, int destination)
+{
+  // CanManager only ever moves one can at a time.
+  if(first != last) {
+    beginResetModel();
+    rows_list_ = matchingRows();
+    endResetModel();
+    return;
+  }
+
+  const int to = (destination > first) ? destination - 1 : destination;
+
+  auto Follow = [&](int source_row) -> int {
+    if(source_row == first)
+      return to;
+    else if(to > first && source_row > first && source_row <= to)
+      return source_row - 1;
+    else if(to < first && source_row >= to && source_row < first)
+      return source_row + 1;
+    else
+      return source_row;
+  };
+
+  int from_row = proxyRow(first);
+
+  // Not shown; the other rows keep their order.
+  if(from_row >= rows_list_.size() || rows_list_.at(from_row) != first) {
+    for(int i = 0; i < rows_list_.size(); ++i)
+      rows_list_[i] = Follow(rows_list_.at(i));
+
+    return;
+  }
+
+  // Where it belongs among the other rows once they've followed too.
+  int to_row = 0;
+
+  for(int i = 0; i < rows_list_.size(); ++i)
+    if(i != from_row && Follow(rows_list_.at(i)) < to)
+      ++to_row;
+
+  bool moved = beginMoveRows(QModelIndex(), from_row, from_row, QModelIndex(),
+                             (to_row > from_row) ? to_row + 1 : to_row);
+
+  rows_list_.remove(from_row);
+
+  for(int i = 0; i < rows_list_.size(); ++i)
+    rows_list_[i] = Follow(rows_list_.at(i));
+
+  rows_list_.insert(to_row, to);
+
+  if(moved)
+    endMoveRows();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Re-checks the changed rows, then passes the change on for those shown.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::sourceDataChanged(const QModelIndex& top_left,
+                                       const QModelIndex& bottom_right,
+                                       const QVector<int>& roles)
+{
+  refilterRows(top_left.row(), bottom_right.row());
+
+  const int begin = proxyRow(top_left.row());
+  const int end = proxyRow(bottom_right.row() + 1);
+
+  if(begin < end)
+    emit dataChanged(index(begin, top_left.column()),
+                     index(end - 1, bottom_right.column()),
+                     roles);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Starts a layout change along with CanManager.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::sourceLayoutAboutToBeChanged()
+{
+  emit layoutAboutToBeChanged();
+  saveLayout();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Finishes a layout change along with CanManager. The cans may have been
+/// edited before the re-sort, so every row is re-checked.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::sourceLayoutChanged()
+{
+  rows_list_ = matchingRows();
+  restoreLayout();
+  emit layoutChanged();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Starts a reset along with CanManager.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::sourceAboutToBeReset()
+{
+  beginResetModel();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Finishes a reset along with CanManager.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModel::sourceReset()
+{
+  rows_list_ = matchingRows();
+  endResetModel();
+}
+
+} // namespace jccu
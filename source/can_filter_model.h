@@ -0,0 +1,107 @@
+#ifndef JCCU_SOURCE_CAN_FILTER_MODEL_H
+#define JCCU_SOURCE_CAN_FILTER_MODEL_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <stdint.h>
+#include <QAbstractProxyModel>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+namespace jccu
+{
+
+class CanManager;
+class DateManager;
+class GoodManager;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Filters the cans by good and by expiration.
+/// Unlike a QSortFilterProxyModel, this never asks CanManager for data to
+/// filter. Cans are sorted by date, so the expiration filters are a range of
+/// rows found by binary search, and goods are checked by id or, when they
+/// have few cans, looked up in CanManager's good index. Filter changes
+/// only notify about the rows that come and go, and a filter that narrows
+/// only re-checks the rows already shown.
+///////////////////////////////////////////////////////////////////////////////
+class CanFilterModel : public QAbstractProxyModel
+{
+  public:
+    enum ExpiryBand {
+      AnyBand,
+      ExpiredBand, // Expired, today included.
+      WeekBand,    // Expiring within the next 7 days.
+      MonthBand    // Expiring within the next 30 days.
+    };
+
+    CanFilterModel(CanManager* can_manager,
+                   GoodManager* good_manager,
+                   DateManager* date_manager,
+                   QObject* parent = nullptr);
+    ~CanFilterModel();
+
+    void setGoodFilter(const QString& query);
+    void setExpiryRange(int64_t first_day, int64_t last_day);
+    void setExpiryBand(ExpiryBand band);
+
+    QModelIndex mapFromSource(const QModelIndex& source_index) const;
+    QModelIndex mapToSource(const QModelIndex& proxy_index) const;
+
+    QModelIndex index(int row,
+                      int column,
+                      const QModelIndex& parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex& child) const;
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+
+  private:
+    CanFilterModel(const CanFilterModel&);
+    CanFilterModel& operator=(const CanFilterModel&);
+
+    void expiryBounds(int64_t* first_day, int64_t* last_day) const;
+    bool accepts(int source_row, int64_t first_day, int64_t last_day) const;
+    QVector<int> matchingRows() const;
+    int proxyRow(int source_row) const;
+
+    void refilter(bool narrowing);
+    void refilterRows(int first, int last);
+    void replaceRows(int first, int last, const QVector<int>& rows);
+    void relayout(const QVector<int>& rows);
+    void saveLayout();
+    void restoreLayout();
+
+    void sourceRowsInserted(int first, int last);
+    void sourceRowsAboutToBeRemoved(int first, int last);
+    void sourceRowsRemoved(int first, int last);
+    void sourceRowsMoved(int first, int last, int destination);
+    void sourceDataChanged(const QModelIndex& top_left,
+                           const QModelIndex& bottom_right,
+                           const QVector<int>& roles);
+    void sourceLayoutAboutToBeChanged();
+    void sourceLayoutChanged();
+    void sourceAboutToBeReset();
+    void sourceReset();
+
+    static const int MaxRuns; // Most runs of rows that come or go to notify
+                              // one by one, rather than as a layout change.
+
+    QVector<int> rows_list_;         // <SourceRow>, ascending.
+    QSet<int> goods_set_;            // <GoodId>
+    QModelIndexList layout_indexes_; // Persistent indexes during a layout
+    QList<int> layout_can_ids_;      // change, and their cans.
+    CanManager* cans_;
+    GoodManager* goods_;
+    DateManager* dates_;
+    QString good_query_; // Empty if goods aren't filtered.
+    int64_t first_day_;  // Expiry range, inclusive.
+    int64_t last_day_;
+    ExpiryBand band_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_CAN_FILTER_MODEL_H
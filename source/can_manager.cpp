@@ -4,20 +4,37 @@
 #include "can_manager.h"
 
 #include <algorithm>
-#include <QBrush>
+#include <limits>
 #include <QDate>
+#include <QDateTime>
+#include <QTime>
+#include <QTimer>
+#include "journal_manager.h"
+#include "metrics.h"
+#include "trace.h"
 
 namespace jccu
 {
 
+const int CanManager::MaxRuns = 32;
+
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Constructor.
 ///////////////////////////////////////////////////////////////////////////////
 CanManager::CanManager(GoodManager* good_manager, DateManager* date_manager)
   : goods_(good_manager),
     dates_(date_manager),
-    last_row_added_(0)
+    valid_rows_(0),
+    midnight_timer_(new QTimer(this)),
+    today_(0),
+    last_row_added_(0),
+    journal_(nullptr),
+    bulk_loading_(false)
 {
+  midnight_timer_->setSingleShot(true);
+  connect(midnight_timer_, &QTimer::timeout, [this]() { refreshToday(); });
+  refreshToday();
 }
 
 
@@ -30,13 +47,19 @@ CanManager::~CanManager()
 
 
 ///////////////////////////////////////////////////////////////////////////////
-/// Adds the can. If the good or date don't exist, they'll be created.
+/// Adds the can, or a lot of quantity cans if quantity > 1. If the good or
+/// date don't exist, they'll be created.
 /// Gets the can id hint from can_id_hint if it's non-null.
 /// Outputs the can id chosen to can_id_hint, if it's non-null.
 /// Returns true on success.
 ///////////////////////////////////////////////////////////////////////////////
-bool CanManager::add(const QString& good, int64_t date, int* can_id_hint)
+bool CanManager::add(const QString& good,
+                     int64_t date,
+                     int* can_id_hint,
+                     int quantity)
 {
+  JCCU_TRACE("CanManager::add");
+
   int good_id, date_id;
 
   // Good already exists. Get the id manually.
@@ -53,20 +76,39 @@ bool CanManager::add(const QString& good, int64_t date, int* can_id_hint)
   if(can_id_hint)
     *can_id_hint = can_id;
 
-  return insert(can_id, good_id, date_id);
+  return insert(can_id, good_id, date_id, quantity);
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-/// Inserts the can if all ids are valid.
-/// good_id and date_id must exist; can_id must not. No id may be < 1.
+/// Inserts the can, or a lot of quantity cans, if all ids are valid.
+/// good_id and date_id must exist; can_id must not. No id or quantity may
+/// be < 1.
+/// During a bulk load the can is appended and its good and date are checked
+/// in endBulkLoad instead.
 /// Returns true on success.
 ///////////////////////////////////////////////////////////////////////////////
-bool CanManager::insert(int can_id, int good_id, int date_id)
+bool CanManager::insert(int can_id, int good_id, int date_id, int quantity)
 {
-  if(can_id < 1 || good_id < 1 || date_id < 1)
+  if(can_id < 1 || good_id < 1 || date_id < 1 || quantity < 1)
     return false;
 
+  if(bulk_loading_) {
+    if(exists(can_id))
+      return false;
+
+    cans_goods_container_.insert(can_id, good_id);
+    cans_dates_container_.insert(can_id, date_id);
+    cans_list_.append(can_id);
+
+    if(quantity > 1)
+      cans_quantities_container_.insert(can_id, quantity);
+
+    return true;
+  }
+
+  JCCU_TRACE("CanManager::insert");
+
   if(!goods_->exists(good_id))
     return false;
 
@@ -76,16 +118,36 @@ bool CanManager::insert(int can_id, int good_id, int date_id)
   if(exists(can_id))
     return false;
 
-  int new_row = cans_list_.size();
+  cans_goods_container_.insert(can_id, good_id);
+  cans_dates_container_.insert(can_id, date_id);
+  ids_.reserve(can_id);
+  linkGood(can_id, good_id);
+  adjustRefCount(&dates_refs_container_, date_id, 1);
+  expirations_.add(dates_->date(date_id), quantity);
+
+  if(quantity > 1)
+    cans_quantities_container_.insert(can_id, quantity);
+
+  // The list is kept sorted, so find where the can belongs.
+  auto Compare = [this](int can_id_a, int can_id_b) -> bool {
+    return lessThan(can_id_a, can_id_b);
+  };
+
+  auto it = std::lower_bound(cans_list_.begin(), cans_list_.end(),
+                             can_id, Compare);
+  int new_row = it - cans_list_.begin();
 
   beginInsertRows(QModelIndex(), new_row, new_row);
-    cans_goods_container_.insert(can_id, good_id);
-    cans_dates_container_.insert(can_id, date_id);
-    cans_list_.append(can_id);
+    cans_list_.insert(new_row, can_id);
+    invalidateRows(new_row);
   endInsertRows();
 
-  sort();
-  last_row_added_ = cans_list_.indexOf(can_id);
+  Metrics::Add(Metrics::RowsInserted);
+
+  last_row_added_ = new_row;
+
+  if(journal_)
+    journal_->canInserted(can_id, good_id, date_id, quantity);
 
   return true;
 }
@@ -97,6 +159,8 @@ bool CanManager::insert(int can_id, int good_id, int date_id)
 ///////////////////////////////////////////////////////////////////////////////
 bool CanManager::editGood(int can_id, const QString& new_good)
 {
+  JCCU_TRACE("CanManager::editGood");
+
   if(!exists(can_id))
     return false;
 
@@ -104,14 +168,23 @@ bool CanManager::editGood(int can_id, const QString& new_good)
     return false;
 
   int good_id = goods_->id(new_good);
+  int old_good_id = cans_goods_container_.value(can_id);
 
-  if(good_id == cans_goods_container_.value(can_id))
+  if(good_id == old_good_id)
     return false;
 
   // Good id is column 1.
-  auto good_index = index(cans_list_.indexOf(can_id), 1);
+  auto good_index = index(row(can_id), 1);
   cans_goods_container_[can_id] = good_id;
+  unlinkGood(can_id, old_good_id);
+  linkGood(can_id, good_id);
   emit dataChanged(good_index, good_index);
+
+  resort(can_id);
+
+  if(journal_)
+    journal_->cansGoodChanged(QList<int>() << can_id, good_id);
+
   return true;
 }
 
@@ -122,6 +195,8 @@ bool CanManager::editGood(int can_id, const QString& new_good)
 ///////////////////////////////////////////////////////////////////////////////
 bool CanManager::editDate(int can_id, int64_t new_date)
 {
+  JCCU_TRACE("CanManager::editDate");
+
   if(!exists(can_id))
     return false;
 
@@ -135,10 +210,19 @@ bool CanManager::editDate(int can_id, int64_t new_date)
     return false;
 
   // Date id is column 2.
-  auto date_index = index(cans_list_.indexOf(can_id), 2);
+  auto date_index = index(row(can_id), 2);
   cans_dates_container_[can_id] = date_id;
+  adjustRefCount(&dates_refs_container_, old_date_id, -1);
+  adjustRefCount(&dates_refs_container_, date_id, 1);
+  expirations_.add(dates_->date(old_date_id), -quantity(can_id));
+  expirations_.add(new_date, quantity(can_id));
   emit dataChanged(date_index, date_index);
 
+  resort(can_id);
+
+  if(journal_)
+    journal_->cansDateChanged(QList<int>() << can_id, date_id);
+
   if(!dateRefCount(old_date_id))
     dates_->remove(dates_->date(old_date_id));
 
@@ -146,24 +230,208 @@ bool CanManager::editDate(int can_id, int64_t new_date)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// Changes the good of all the given cans to new_good.
+/// new_good must already exist. The cans are re-sorted once at the end.
+/// Returns the number of cans changed.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::editGoods(const QList<int>& can_ids, const QString& new_good)
+{
+  JCCU_TRACE("CanManager::editGoods");
+  LatencyTimer timer(Metrics::BulkEdit);
+
+  if(!goods_->exists(new_good))
+    return 0;
+
+  int good_id = goods_->id(new_good);
+  QList<int> changed_ids;
+
+  auto it = can_ids.constBegin(),
+       end = can_ids.constEnd();
+
+  for(; it != end; ++it) {
+    auto good_it = cans_goods_container_.find(*it);
+
+    if(good_it == cans_goods_container_.end() || *good_it == good_id)
+      continue;
+
+    unlinkGood(*it, *good_it);
+    linkGood(*it, good_id);
+    *good_it = good_id;
+    changed_ids.append(*it);
+  }
+
+  if(changed_ids.isEmpty())
+    return 0;
+
+  sort();
+
+  if(journal_)
+    journal_->cansGoodChanged(changed_ids, good_id);
+
+  return changed_ids.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Changes the date of all the given cans to new_date.
+/// new_date is created if it doesn't exist. The cans are re-sorted once at
+/// the end, and dates that are no longer referenced are removed.
+/// Returns the number of cans changed.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::editDates(const QList<int>& can_ids, int64_t new_date)
+{
+  JCCU_TRACE("CanManager::editDates");
+  LatencyTimer timer(Metrics::BulkEdit);
+
+  if(!dates_->exists(new_date))
+    dates_->add(new_date);
+
+  int date_id = dates_->id(new_date);
+  QList<int> old_date_ids;
+  QList<int> changed_ids;
+
+  auto it = can_ids.constBegin(),
+       end = can_ids.constEnd();
+
+  for(; it != end; ++it) {
+    auto date_it = cans_dates_container_.find(*it);
+
+    if(date_it == cans_dates_container_.end() || *date_it == date_id)
+      continue;
+
+    const int can_quantity = quantity(*it);
+
+    old_date_ids.append(*date_it);
+    adjustRefCount(&dates_refs_container_, *date_it, -1);
+    adjustRefCount(&dates_refs_container_, date_id, 1);
+    expirations_.add(dates_->date(*date_it), -can_quantity);
+    expirations_.add(new_date, can_quantity);
+    *date_it = date_id;
+    changed_ids.append(*it);
+  }
+
+  if(!changed_ids.isEmpty())
+    sort();
+
+  if(journal_ && !changed_ids.isEmpty())
+    journal_->cansDateChanged(changed_ids, date_id);
+
+  auto date_it = old_date_ids.constBegin(),
+       date_end = old_date_ids.constEnd();
+
+  // A date can appear more than once; the first removal drops it.
+  for(; date_it != date_end; ++date_it)
+    if(!dateRefCount(*date_it) && dates_->exists(*date_it))
+      dates_->remove(dates_->date(*date_it));
+
+  if(!dateRefCount(date_id))
+    dates_->remove(new_date);
+
+  return changed_ids.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets how many cans the given can stands for; more than one makes it a
+/// lot. Only the can's quantity cell changes, since rows aren't sorted by
+/// quantity, so this is O(1). quantity must be >= 1; use remove to drop the
+/// last can.
+/// Returns true if the quantity changed.
+///////////////////////////////////////////////////////////////////////////////
+bool CanManager::setQuantity(int can_id, int quantity)
+{
+  JCCU_TRACE("CanManager::setQuantity");
+
+  if(!exists(can_id) || quantity < 1)
+    return false;
+
+  int old_quantity = this->quantity(can_id);
+
+  if(quantity == old_quantity)
+    return false;
+
+  if(quantity > 1)
+    cans_quantities_container_[can_id] = quantity;
+  else
+    cans_quantities_container_.remove(can_id);
+
+  expirations_.add(dates_->date(cans_dates_container_.value(can_id)),
+                   quantity - old_quantity);
+
+  // Quantity is column 3.
+  auto quantity_index = index(row(can_id), 3);
+  emit dataChanged(quantity_index, quantity_index);
+
+  if(journal_)
+    journal_->canQuantityChanged(can_id, quantity);
+
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Splits quantity cans off the given lot into a new can (or lot) with the
+/// same good and date, so they can be edited or removed on their own.
+/// quantity must be less than the lot's.
+/// Returns the new can's id, or zero on failure.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::splitLot(int can_id, int quantity)
+{
+  JCCU_TRACE("CanManager::splitLot");
+
+  int lot_quantity = this->quantity(can_id);
+
+  if(quantity < 1 || quantity >= lot_quantity)
+    return 0;
+
+  int new_can_id = nextId(0);
+
+  setQuantity(can_id, lot_quantity - quantity);
+  insert(new_can_id,
+         cans_goods_container_.value(can_id),
+         cans_dates_container_.value(can_id),
+         quantity);
+
+  return new_can_id;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Removes the can if it exists.
 /// Returns true on success.
 ///////////////////////////////////////////////////////////////////////////////
 bool CanManager::remove(int id)
 {
+  JCCU_TRACE("CanManager::remove");
+
   if(!exists(id))
     return false;
 
-  int index = cans_list_.indexOf(id);
+  int index = row(id);
+  int good_id = cans_goods_container_.value(id);
   int date_id = cans_dates_container_.value(id);
+  int can_quantity = quantity(id);
 
   beginRemoveRows(QModelIndex(), index, index);
     cans_goods_container_.remove(id);
     cans_dates_container_.remove(id);
-    cans_list_.removeOne(id);
+    cans_quantities_container_.remove(id);
+    cans_rows_container_.remove(id);
+    cans_list_.removeAt(index);
+    ids_.release(id);
+    invalidateRows(index);
   endRemoveRows();
 
+  Metrics::Add(Metrics::RowsRemoved);
+
+  unlinkGood(id, good_id);
+  adjustRefCount(&dates_refs_container_, date_id, -1);
+  expirations_.add(dates_->date(date_id), -can_quantity);
+
+  if(journal_)
+    journal_->cansRemoved(QList<int>() << id);
+
   if(!dateRefCount(date_id))
     dates_->remove(dates_->date(date_id));
 
@@ -171,20 +439,223 @@ bool CanManager::remove(int id)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// Removes all of the given cans that exist.
+/// Each contiguous run of rows is removed with a single notification. Past
+/// MaxRuns runs, the survivors are compacted in one pass under a single model
+/// reset instead.
+/// Returns the number of cans removed.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::removeMany(const QList<int>& can_ids)
+{
+  JCCU_TRACE("CanManager::removeMany");
+  LatencyTimer timer(Metrics::BulkEdit);
+
+  QList<int> rows;
+  rows.reserve(can_ids.size());
+
+  auto it = can_ids.constBegin(),
+       end = can_ids.constEnd();
+
+  for(; it != end; ++it)
+    if(exists(*it))
+      rows.append(row(*it));
+
+  if(rows.isEmpty())
+    return 0;
+
+  std::sort(rows.begin(), rows.end());
+  rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+  QList<int> removed_ids;
+  QList<int> old_date_ids;
+
+  auto Take = [&](int can_id) {
+    int can_quantity = quantity(can_id);
+    int good_id = cans_goods_container_.take(can_id);
+    int date_id = cans_dates_container_.take(can_id);
+
+    unlinkGood(can_id, good_id);
+    adjustRefCount(&dates_refs_container_, date_id, -1);
+    expirations_.add(dates_->date(date_id), -can_quantity);
+    cans_quantities_container_.remove(can_id);
+    cans_rows_container_.remove(can_id);
+    ids_.release(can_id);
+    removed_ids.append(can_id);
+    old_date_ids.append(date_id);
+  };
+
+  int runs = 1;
+
+  for(int i = 1; i < rows.size(); ++i)
+    if(rows.at(i) != rows.at(i - 1) + 1)
+      ++runs;
+
+  if(runs > MaxRuns) {
+    const int first_row = rows.first();
+    int kept = first_row;
+    int next = 0;
+
+    beginResetModel();
+      for(int i = first_row; i < cans_list_.size(); ++i) {
+        if(next < rows.size() && rows.at(next) == i) {
+          Take(cans_list_.at(i));
+          ++next;
+        }
+        else {
+          cans_list_[kept++] = cans_list_.at(i);
+        }
+      }
+
+      cans_list_.erase(cans_list_.begin() + kept, cans_list_.end());
+      invalidateRows(first_row);
+    endResetModel();
+
+    Metrics::Add(Metrics::RowsRemoved, rows.size());
+  }
+  else {
+    int last = rows.size() - 1;
+
+    // Work backwards so the rows still to be removed don't shift.
+    while(last >= 0) {
+      int first = last;
+
+      while(first > 0 && rows.at(first - 1) == rows.at(first) - 1)
+        --first;
+
+      const int first_row = rows.at(first),
+                last_row = rows.at(last);
+
+      beginRemoveRows(QModelIndex(), first_row, last_row);
+        for(int i = first_row; i <= last_row; ++i)
+          Take(cans_list_.at(i));
+
+        cans_list_.erase(cans_list_.begin() + first_row,
+                         cans_list_.begin() + last_row + 1);
+        invalidateRows(first_row);
+      endRemoveRows();
+
+      Metrics::Add(Metrics::RowsRemoved, last_row - first_row + 1);
+
+      last = first - 1;
+    }
+  }
+
+  if(journal_)
+    journal_->cansRemoved(removed_ids);
+
+  auto date_it = old_date_ids.constBegin(),
+       date_end = old_date_ids.constEnd();
+
+  // A date can appear more than once; the first removal drops it.
+  for(; date_it != date_end; ++date_it)
+    if(!dateRefCount(*date_it) && dates_->exists(*date_it))
+      dates_->remove(dates_->date(*date_it));
+
+  return rows.size();
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Removes all cans with good id good_id.
+/// Only the good's cans are looked at, and each contiguous run of their rows
+/// is removed at once.
 /// Returns the number of cans removed.
 ///////////////////////////////////////////////////////////////////////////////
 int CanManager::removeByGood(int good_id)
 {
-  auto can_ids = cans_goods_container_.keys(good_id);
+  JCCU_TRACE("CanManager::removeByGood");
+
+  return removeMany(goodCans(good_id).toList());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Removes all cans that expired before day (a Julian day).
+/// Rows are sorted by date first, so they're the rows before
+/// firstRowOnOrAfter(day), removed with a single notification. Every date
+/// they reference is left unreferenced and removed too, in one batch.
+/// Returns the number of cans removed.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::removeExpiredBefore(int64_t day)
+{
+  JCCU_TRACE("CanManager::removeExpiredBefore");
+  LatencyTimer timer(Metrics::BulkEdit);
+
+  const int count = firstRowOnOrAfter(day);
+
+  if(!count)
+    return 0;
+
+  QList<int> removed_ids;
+  QList<int> old_date_ids;
+  removed_ids.reserve(count);
+
+  beginRemoveRows(QModelIndex(), 0, count - 1);
+    for(int i = 0; i < count; ++i) {
+      int can_id = cans_list_.at(i);
+      int good_id = cans_goods_container_.take(can_id);
+      int date_id = cans_dates_container_.take(can_id);
+
+      // All of a date's cans go, so its counts are dropped all at once.
+      // Lots make its can count differ from its ref count.
+      auto date_it = dates_refs_container_.find(date_id);
+
+      if(date_it != dates_refs_container_.end()) {
+        int64_t date = dates_->date(date_id);
+
+        expirations_.add(date, -expirations_.countOn(date));
+        dates_refs_container_.erase(date_it);
+        old_date_ids.append(date_id);
+      }
+
+      unlinkGood(can_id, good_id);
+      cans_quantities_container_.remove(can_id);
+      cans_rows_container_.remove(can_id);
+      ids_.release(can_id);
+      removed_ids.append(can_id);
+    }
+
+    cans_list_.erase(cans_list_.begin(), cans_list_.begin() + count);
+    invalidateRows(0);
+  endRemoveRows();
+
+  Metrics::Add(Metrics::RowsRemoved, count);
+
+  if(journal_)
+    journal_->cansRemoved(removed_ids);
+
+  dates_->removeMany(old_date_ids);
+
+  return count;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Takes one can from each of the given cans: lots are decremented in
+/// place, and single cans are removed together.
+/// Returns the number of cans taken.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::takeOne(const QList<int>& can_ids)
+{
+  JCCU_TRACE("CanManager::takeOne");
+
+  QList<int> single_ids;
+  int taken = 0;
+
   auto it = can_ids.constBegin(),
        end = can_ids.constEnd();
 
-  for(; it != end; ++it)
-    remove(*it);
+  for(; it != end; ++it) {
+    auto quantity_it = cans_quantities_container_.constFind(*it);
 
-  return can_ids.count();
+    if(quantity_it == cans_quantities_container_.constEnd())
+      single_ids.append(*it);
+    else if(setQuantity(*it, *quantity_it - 1))
+      ++taken;
+  }
+
+  return taken + removeMany(single_ids);
 }
 
 
@@ -193,6 +664,8 @@ int CanManager::removeByGood(int good_id)
 ///////////////////////////////////////////////////////////////////////////////
 void CanManager::clear()
 {
+  JCCU_TRACE("CanManager::clear");
+
   const int size = cans_list_.size();
 
   if(!size)
@@ -201,16 +674,134 @@ void CanManager::clear()
   beginRemoveRows(QModelIndex(), 0, size - 1);
     cans_goods_container_.clear();
     cans_dates_container_.clear();
+    cans_quantities_container_.clear();
+    cans_rows_container_.clear();
+    goods_cans_container_.clear();
+    dates_refs_container_.clear();
     cans_list_.clear();
+    ids_.clear();
+    expirations_.clear();
+    invalidateRows(0);
   endRemoveRows();
+
+  Metrics::Add(Metrics::RowsRemoved, size);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Clears all cans and starts a bulk load.
+/// Until endBulkLoad, insert only appends and the model emits nothing but a
+/// single reset. Nothing else may be called in between.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::beginBulkLoad()
+{
+  clear();
+  beginResetModel();
+  bulk_loading_ = true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Drops cans whose good or date doesn't exist, rebuilds the indexes and
+/// sorts once. The good and date managers must have finished loading.
+/// Returns the number of cans dropped.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::endBulkLoad()
+{
+  JCCU_TRACE("CanManager::endBulkLoad");
+
+  if(!bulk_loading_)
+    return 0;
+
+  QList<int> cans_list;
+  cans_list.reserve(cans_list_.size());
+
+  auto it = cans_list_.constBegin(),
+       end = cans_list_.constEnd();
+
+  for(; it != end; ++it) {
+    int good_id = cans_goods_container_.value(*it);
+    int date_id = cans_dates_container_.value(*it);
+
+    if(!goods_->exists(good_id) || !dates_->exists(date_id)) {
+      cans_goods_container_.remove(*it);
+      cans_dates_container_.remove(*it);
+      cans_quantities_container_.remove(*it);
+      continue;
+    }
+
+    cans_list.append(*it);
+    ids_.reserve(*it);
+    linkGood(*it, good_id);
+    adjustRefCount(&dates_refs_container_, date_id, 1);
+  }
+
+  int dropped = cans_list_.size() - cans_list.size();
+
+  auto Compare = [this](int can_id_a, int can_id_b) -> bool {
+    return lessThan(can_id_a, can_id_b);
+  };
+
+  std::sort(cans_list.begin(), cans_list.end(), Compare);
+  cans_list_ = cans_list;
+  invalidateRows(0);
+
+  // Rows are sorted by date, so the expiration index only ever appends.
+  for(it = cans_list_.constBegin(), end = cans_list_.constEnd();
+      it != end; ++it)
+    expirations_.add(dates_->date(cans_dates_container_.value(*it)),
+                     quantity(*it));
+
+  bulk_loading_ = false;
+  endResetModel();
+
+  return dropped;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-/// Returns the can id, good, or date at the given index.
+/// Exchanges all cans with other's in a single reset.
+/// Rows are ordered by good rank, so the good and date managers have to be
+/// swapped with other's first. Other emits nothing. Neither may be bulk
+/// loading.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::swap(CanManager* other)
+{
+  JCCU_TRACE("CanManager::swap");
+
+  beginResetModel();
+  cans_goods_container_.swap(other->cans_goods_container_);
+  cans_dates_container_.swap(other->cans_dates_container_);
+  cans_quantities_container_.swap(other->cans_quantities_container_);
+  cans_list_.swap(other->cans_list_);
+  cans_rows_container_.swap(other->cans_rows_container_);
+  goods_cans_container_.swap(other->goods_cans_container_);
+  dates_refs_container_.swap(other->dates_refs_container_);
+  qSwap(valid_rows_, other->valid_rows_);
+  qSwap(ids_, other->ids_);
+  qSwap(expirations_, other->expirations_);
+  qSwap(last_row_added_, other->last_row_added_);
+  endResetModel();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets the journal that changes to the cans are recorded to, if any.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::setJournal(JournalManager* journal)
+{
+  journal_ = journal;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the can id, good, date or quantity at the given index.
+/// Each role only looks up what it returns; this runs for every visible cell.
 ///////////////////////////////////////////////////////////////////////////////
 QVariant CanManager::data(const QModelIndex& index, int role) const
 {
+  Metrics::AddDataCall(role);
+
   if(!index.isValid())
     return QVariant();
 
@@ -221,37 +812,32 @@ QVariant CanManager::data(const QModelIndex& index, int role) const
     return QVariant();
 
   int can_id = cans_list_.at(index.row());
-  int good_id = cans_goods_container_.value(can_id);
-  int date_id = cans_dates_container_.value(can_id);
-  QDate can_date = QDate::fromJulianDay(dates_->date(date_id));
-  int days_to_expiration = QDate::currentDate().daysTo(can_date);
 
   switch(role) {
     case Qt::DisplayRole:
       if(index.column() == 0)
         return can_id;
       else if(index.column() == 1)
-        return goods_->good(good_id);
-      else // if(index.column() == 2)
-        return can_date;
-      
+        return goods_->good(cans_goods_container_.value(can_id));
+      else if(index.column() == 2)
+        return QDate::fromJulianDay(
+                 dates_->date(cans_dates_container_.value(can_id)));
+      else // if(index.column() == 3)
+        return cans_quantities_container_.value(can_id, 1);
+
     case Qt::ForegroundRole:
-      if(days_to_expiration <= 0)
-        return QBrush(Qt::red);
-      else if(days_to_expiration <= 7)
-        return QBrush(QColor(255, 127, 0)); // Orange
-      else if(days_to_expiration <= 30)
-        return QBrush(QColor(205, 0, 205)); // Purple
-      else
-        return QBrush(Qt::black);
+      return expirationBrush(
+               dates_->date(cans_dates_container_.value(can_id)) - today_);
 
     case IdRole:
       if(index.column() == 0)
         return can_id;
       else if(index.column() == 1)
-        return good_id;
-      else // if(index.column() == 2)
-        return date_id;
+        return cans_goods_container_.value(can_id);
+      else if(index.column() == 2)
+        return cans_dates_container_.value(can_id);
+      else // Quantity has no id.
+        return QVariant();
 
     default:
       return QVariant();
@@ -277,6 +863,8 @@ QVariant CanManager::headerData(int section,
     return QString("Good");
   else if(section == 2)
     return QString("Expires");
+  else if(section == 3)
+    return QString("Quantity");
   else
     return QVariant();
 }
@@ -287,8 +875,8 @@ QVariant CanManager::headerData(int section,
 ///////////////////////////////////////////////////////////////////////////////
 int CanManager::columnCount(const QModelIndex& parent) const
 {
-  // CanId, Good, Date
-  return 3;
+  // CanId, Good, Date, Quantity
+  return 4;
 }
 
 
@@ -303,28 +891,42 @@ int CanManager::rowCount(const QModelIndex& parent) const
 
 ///////////////////////////////////////////////////////////////////////////////
 /// Sorts by date, then good, and finally can id. Ascending.
+/// Persistent indexes (e.g. the view's selection) follow their cans.
 ///////////////////////////////////////////////////////////////////////////////
 void CanManager::sort(int column, Qt::SortOrder order)
 {
+  JCCU_TRACE("CanManager::sort");
+  LatencyTimer timer(Metrics::Sort);
+  Metrics::Add(Metrics::Sorts);
+
   auto Compare = [this](int can_id_a, int can_id_b) -> bool {
-    int64_t date_a = dates_->date(cans_dates_container_.value(can_id_a)),
-            date_b = dates_->date(cans_dates_container_.value(can_id_b));
+    return lessThan(can_id_a, can_id_b);
+  };
 
-    if(date_a != date_b)
-      return date_a < date_b;
+  emit layoutAboutToBeChanged();
 
-    QString good_a = goods_
-                     ->good(cans_goods_container_.value(can_id_a)).toLower(),
-            good_b = goods_
-                     ->good(cans_goods_container_.value(can_id_b)).toLower();
+  auto old_indexes = persistentIndexList();
+  QList<int> persistent_can_ids;
+  persistent_can_ids.reserve(old_indexes.size());
 
-    if(good_a != good_b)
-      return good_a < good_b;
+  auto it = old_indexes.constBegin(),
+       end = old_indexes.constEnd();
 
-    return can_id_a < can_id_b;
-  };
+  for(; it != end; ++it)
+    persistent_can_ids.append(cans_list_.at(it->row()));
 
   std::sort(cans_list_.begin(), cans_list_.end(), Compare);
+  invalidateRows(0);
+
+  QModelIndexList new_indexes;
+  new_indexes.reserve(old_indexes.size());
+
+  for(int i = 0; i < old_indexes.size(); ++i)
+    new_indexes.append(index(row(persistent_can_ids.at(i)),
+                             old_indexes.at(i).column()));
+
+  changePersistentIndexList(old_indexes, new_indexes);
+  emit layoutChanged();
 }
 
 
@@ -333,7 +935,7 @@ void CanManager::sort(int column, Qt::SortOrder order)
 ///////////////////////////////////////////////////////////////////////////////
 bool CanManager::exists(int id) const
 {
-  return cans_list_.contains(id);
+  return cans_goods_container_.contains(id);
 }
 
 
@@ -342,41 +944,109 @@ bool CanManager::exists(int id) const
 //////////////////////////////////////////////////////////////////////////////
 int CanManager::expiringWithin(int days) const
 {
-  auto current_date = QDate::currentDate();
-  auto it = cans_list_.constBegin(),
-       end = cans_list_.constEnd();
-  int matches = 0;
+  JCCU_TRACE("CanManager::expiringWithin");
 
-  for(; it != end; ++it) {
-    auto date = QDate::fromJulianDay(
-                       dates_->date(cans_dates_container_.value(*it)));
-    int days_to_expiration = current_date.daysTo(date);
+  return expiringOnOrBefore(today_ + days);
+}
 
-    if(days_to_expiration <= days)
-      ++matches;
-  }
 
-  return matches;
+//////////////////////////////////////////////////////////////////////////////
+/// Returns the number of cans expiring on or before the given Julian day.
+//////////////////////////////////////////////////////////////////////////////
+int CanManager::expiringOnOrBefore(int64_t day) const
+{
+  return expirations_.countOnOrBefore(day);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the good id of every can by can id.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, int>& CanManager::goodIds() const
+{
+  return cans_goods_container_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the date id of every can by can id.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, int>& CanManager::dateIds() const
+{
+  return cans_dates_container_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the quantity of every lot by can id. Single cans aren't listed.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, int>& CanManager::lotQuantities() const
+{
+  return cans_quantities_container_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns how many cans the given can stands for: its quantity if it's a
+/// lot, otherwise one. Returns zero if the can doesn't exist.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::quantity(int can_id) const
+{
+  if(!exists(can_id))
+    return 0;
+
+  return cans_quantities_container_.value(can_id, 1);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns how many cans the given cans stand for, lots included.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::totalQuantity(const QList<int>& can_ids) const
+{
+  int total = 0;
+
+  auto it = can_ids.constBegin(),
+       end = can_ids.constEnd();
+
+  for(; it != end; ++it)
+    total += quantity(*it);
+
+  return total;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
 /// Returns the number of cans that reference the good with id good_id.
+/// A lot counts once.
 ///////////////////////////////////////////////////////////////////////////////
 int CanManager::goodRefCount(int good_id) const
 {
-  auto good_ids = cans_goods_container_.values();
-  return good_ids.count(good_id);
+  auto it = goods_cans_container_.constFind(good_id);
+
+  if(it == goods_cans_container_.constEnd())
+    return 0;
+
+  return it->size();
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-/// Returns the number of cans that reference the good with id good_id.
+/// Returns the ids of the cans that reference the good with id good_id.
+///////////////////////////////////////////////////////////////////////////////
+QSet<int> CanManager::goodCans(int good_id) const
+{
+  return goods_cans_container_.value(good_id);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of cans that reference the date with id date_id.
+/// A lot counts once.
 ///////////////////////////////////////////////////////////////////////////////
 int CanManager::dateRefCount(int date_id) const
 {
-  auto date_ids = cans_dates_container_.values();
-  return date_ids.count(date_id);
+  return dates_refs_container_.value(date_id);
 }
 
 
@@ -386,12 +1056,46 @@ int CanManager::dateRefCount(int date_id) const
 ///////////////////////////////////////////////////////////////////////////////
 int CanManager::row(int can_id) const
 {
-  int row = 0;
+  auto it = cans_rows_container_.constFind(can_id);
 
-  if(exists(can_id))
-    row = cans_list_.indexOf(can_id);
+  if(it != cans_rows_container_.constEnd() && *it < valid_rows_)
+    return *it;
+
+  if(!exists(can_id))
+    return 0;
+
+  refreshRows();
+  return cans_rows_container_.value(can_id);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the id of the can in the given row.
+/// Returns zero if there's no such row.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::id(int row) const
+{
+  if(row < 0 || row >= cans_list_.size())
+    return 0;
 
-  return row;
+  return cans_list_.at(row);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the first row whose can expires on or after day, or the row count
+/// if there's none. Rows are sorted by date first, so this is a binary search.
+///////////////////////////////////////////////////////////////////////////////
+int CanManager::firstRowOnOrAfter(int64_t day) const
+{
+  auto Compare = [this](int can_id, int64_t bound) -> bool {
+    return dates_->date(cans_dates_container_.value(can_id)) < bound;
+  };
+
+  auto it = std::lower_bound(cans_list_.constBegin(), cans_list_.constEnd(),
+                             day, Compare);
+
+  return it - cans_list_.constBegin();
 }
 
 
@@ -404,6 +1108,35 @@ int CanManager::lastRowAdded() const
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// Outputs the rows of the cans expiring from first_day to last_day,
+/// inclusive (Julian days): first_row up to but not including end_row.
+/// Rows are sorted by date first, so they're contiguous and found by binary
+/// search. Both are the same row if no can expires then.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::rowsExpiringBetween(int64_t first_day, int64_t last_day,
+                                     int* first_row, int* end_row) const
+{
+  *first_row = firstRowOnOrAfter(first_day);
+
+  if(last_day < first_day)
+    *end_row = *first_row;
+  else if(last_day == std::numeric_limits<int64_t>::max())
+    *end_row = cans_list_.size();
+  else
+    *end_row = firstRowOnOrAfter(last_day + 1);
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+/// Returns today's Julian day, as used for the expiration colors.
+//////////////////////////////////////////////////////////////////////////////
+int64_t CanManager::today() const
+{
+  return today_;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Returns the smallest available can id.
 /// It will return hint if it's available and > 0.
@@ -413,17 +1146,167 @@ int CanManager::nextId(int hint) const
   if(hint > 0 && !exists(hint))
     return hint;
 
-  auto can_ids = cans_list_;
-  std::sort(can_ids.begin(), can_ids.end());
+  return ids_.next();
+}
+
 
-  int i = 1;
-  const int size = can_ids.size();
+///////////////////////////////////////////////////////////////////////////////
+/// Adds delta to the reference count of id in ref_counts.
+/// Ids whose count drops to zero are dropped from the table.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::adjustRefCount(QHash<int, int>* ref_counts, int id, int delta)
+{
+  int& count = (*ref_counts)[id];
+  count += delta;
+
+  if(count <= 0)
+    ref_counts->remove(id);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Adds the can to its good's cans.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::linkGood(int can_id, int good_id)
+{
+  goods_cans_container_[good_id].insert(can_id);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Removes the can from its good's cans.
+/// Goods left without cans are dropped from the table.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::unlinkGood(int can_id, int good_id)
+{
+  auto it = goods_cans_container_.find(good_id);
+
+  if(it == goods_cans_container_.end())
+    return;
+
+  it->remove(can_id);
+
+  if(it->isEmpty())
+    goods_cans_container_.erase(it);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if can a sorts before can b.
+/// Orders by date, then good, and finally can id. Ascending.
+///////////////////////////////////////////////////////////////////////////////
+bool CanManager::lessThan(int can_id_a, int can_id_b) const
+{
+  int64_t date_a = dates_->date(cans_dates_container_.value(can_id_a)),
+          date_b = dates_->date(cans_dates_container_.value(can_id_b));
+
+  if(date_a != date_b)
+    return date_a < date_b;
+
+  // Ranks follow the goods' collation order, so no strings are compared.
+  int good_a = goods_->rank(cans_goods_container_.value(can_id_a)),
+      good_b = goods_->rank(cans_goods_container_.value(can_id_b));
+
+  if(good_a != good_b)
+    return good_a < good_b;
+
+  return can_id_a < can_id_b;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Moves the can to its sorted row after its good or date changed.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::resort(int can_id)
+{
+  auto Compare = [this](int can_id_a, int can_id_b) -> bool {
+    return lessThan(can_id_a, can_id_b);
+  };
+
+  int from = row(can_id);
+
+  // Find the new row among the other cans.
+  cans_list_.removeAt(from);
+  auto it = std::lower_bound(cans_list_.begin(), cans_list_.end(),
+                             can_id, Compare);
+  int to = it - cans_list_.begin();
+  cans_list_.insert(from, can_id);
+
+  if(to == from)
+    return;
+
+  // The destination is given in terms of the rows before the move.
+  beginMoveRows(QModelIndex(), from, from,
+                QModelIndex(), (to > from) ? to + 1 : to);
+    cans_list_.move(from, to);
+    invalidateRows(std::min(from, to));
+  endMoveRows();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Re-reads the current date and schedules the next refresh for midnight.
+/// Expiration colors are relative to today, so they're all invalidated.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::refreshToday()
+{
+  JCCU_TRACE("CanManager::refreshToday");
+
+  auto now = QDateTime::currentDateTime();
+  auto midnight = QDateTime(now.date().addDays(1), QTime(0, 0));
+
+  today_ = now.date().toJulianDay();
+  midnight_timer_->start(now.msecsTo(midnight) + 1000);
+
+  if(!cans_list_.isEmpty())
+    emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1),
+                     QVector<int>() << Qt::ForegroundRole);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the foreground brush for a can expiring in the given days.
+/// The brushes are built once and shared.
+///////////////////////////////////////////////////////////////////////////////
+const QBrush& CanManager::expirationBrush(int64_t days_to_expiration)
+{
+  static const QBrush Expired(Qt::red);
+  static const QBrush Week(QColor(255, 127, 0));  // Orange
+  static const QBrush Month(QColor(205, 0, 205)); // Purple
+  static const QBrush Fresh(Qt::black);
+
+  if(days_to_expiration <= 0)
+    return Expired;
+  else if(days_to_expiration <= 7)
+    return Week;
+  else if(days_to_expiration <= 30)
+    return Month;
+  else
+    return Fresh;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Marks every row from first_row onwards as needing to be re-indexed.
+/// Rows above first_row keep their cached positions.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::invalidateRows(int first_row)
+{
+  valid_rows_ = std::min(valid_rows_, first_row);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Re-indexes the rows that were invalidated since the last refresh.
+///////////////////////////////////////////////////////////////////////////////
+void CanManager::refreshRows() const
+{
+  const int size = cans_list_.size();
 
-  for(; i <= size; ++i)
-    if(i < can_ids[i - 1])
-      break;
+  for(int i = valid_rows_; i < size; ++i)
+    cans_rows_container_[cans_list_.at(i)] = i;
 
-  return i;
+  valid_rows_ = size;
 }
 
 } // namespace jccu
\ No newline at end of file
@@ -5,15 +5,27 @@
 /// Includes
 ///////////////////////////////////////////////////////////////////////////////
 #include <QAbstractTableModel>
+#include <QBrush>
 #include <QHash>
+#include <QSet>
 #include "date_manager.h"
+#include "expiration_index.h"
 #include "good_manager.h"
+#include "id_allocator.h"
+
+class QTimer;
 
 namespace jccu
 {
 
+class JournalManager;
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Manages all cans. This class has terrible container names. Sorry.
+/// A row can also be a lot: a quantity of identical cans (same good and
+/// date) under one can id. Only lots have an entry in the quantities table,
+/// so single cans cost nothing extra. Expiration counts are in cans; ref
+/// counts and row counts are in rows.
 ///////////////////////////////////////////////////////////////////////////////
 class CanManager : public QAbstractTableModel
 {
@@ -25,16 +37,32 @@ class CanManager : public QAbstractTableModel
     CanManager(GoodManager* good_manager, DateManager* date_manager);
     ~CanManager();
 
-    bool add(const QString& good, int64_t date, int* can_id_hint = nullptr);
-    bool insert(int can_id, int good_id, int date_id);
+    bool add(const QString& good,
+             int64_t date,
+             int* can_id_hint = nullptr,
+             int quantity = 1);
+    bool insert(int can_id, int good_id, int date_id, int quantity = 1);
 
     bool editGood(int can_id, const QString& new_good);
     bool editDate(int can_id, int64_t new_date);
+    int editGoods(const QList<int>& can_ids, const QString& new_good);
+    int editDates(const QList<int>& can_ids, int64_t new_date);
+    bool setQuantity(int can_id, int quantity);
+    int splitLot(int can_id, int quantity = 1);
 
     bool remove(int id);
+    int removeMany(const QList<int>& can_ids);
     int removeByGood(int good_id);
+    int removeExpiredBefore(int64_t day);
+    int takeOne(const QList<int>& can_ids);
     void clear();
 
+    void beginBulkLoad();
+    int endBulkLoad();
+    void swap(CanManager* other);
+
+    void setJournal(JournalManager* journal);
+
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
     QVariant headerData(int section,
                         Qt::Orientation orientation,
@@ -47,10 +75,22 @@ class CanManager : public QAbstractTableModel
 
     bool exists(int id) const;
     int expiringWithin(int days) const;
+    int expiringOnOrBefore(int64_t day) const;
+    const QHash<int, int>& goodIds() const;
+    const QHash<int, int>& dateIds() const;
+    const QHash<int, int>& lotQuantities() const;
+    int quantity(int can_id) const;
+    int totalQuantity(const QList<int>& can_ids) const;
     int goodRefCount(int good_id) const;
+    QSet<int> goodCans(int good_id) const;
     int dateRefCount(int date_id) const;
     int row(int can_id) const;
+    int id(int row) const;
+    int firstRowOnOrAfter(int64_t day) const;
+    void rowsExpiringBetween(int64_t first_day, int64_t last_day,
+                             int* first_row, int* end_row) const;
     int lastRowAdded() const;
+    int64_t today() const;
     
     int nextId(int hint) const;
 
@@ -58,12 +98,37 @@ class CanManager : public QAbstractTableModel
     CanManager(const CanManager&);
     CanManager& operator=(const CanManager&);
 
-    QHash<int, int> cans_goods_container_; // <CanId, GoodId>
-    QHash<int, int> cans_dates_container_; // <CanId, DateId>
-    QList<int> cans_list_;                 // <CanId>
+    void adjustRefCount(QHash<int, int>* ref_counts, int id, int delta);
+    void linkGood(int can_id, int good_id);
+    void unlinkGood(int can_id, int good_id);
+    bool lessThan(int can_id_a, int can_id_b) const;
+    void resort(int can_id);
+    void refreshToday();
+
+    static const QBrush& expirationBrush(int64_t days_to_expiration);
+    void invalidateRows(int first_row);
+    void refreshRows() const;
+
+    static const int MaxRuns; // Most runs of rows that go to notify one by
+                              // one, rather than as a model reset.
+
+    QHash<int, int> cans_goods_container_;        // <CanId, GoodId>
+    QHash<int, int> cans_dates_container_;        // <CanId, DateId>
+    QHash<int, int> cans_quantities_container_;   // <CanId, Quantity>, lots
+    QList<int> cans_list_;                        // <CanId>
+    mutable QHash<int, int> cans_rows_container_; // <CanId, Row>
+    QHash<int, QSet<int> > goods_cans_container_; // <GoodId, CanIds>
+    QHash<int, int> dates_refs_container_;        // <DateId, CanCount>
     GoodManager* goods_;
     DateManager* dates_;
+    mutable int valid_rows_; // Rows below this are correctly indexed.
+    IdAllocator ids_;
+    ExpirationIndex expirations_;
+    QTimer* midnight_timer_;
+    int64_t today_; // Julian day, refreshed at midnight.
     int last_row_added_;
+    JournalManager* journal_;
+    bool bulk_loading_;
 };
 
 } // namespace jccu
@@ -3,7 +3,10 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include "date_manager.h"
 
-#include <algorithm>
+#include <QSet>
+#include "journal_manager.h"
+#include "metrics.h"
+#include "trace.h"
 
 namespace jccu
 {
@@ -12,6 +15,8 @@ namespace jccu
 /// Constructor.
 ///////////////////////////////////////////////////////////////////////////////
 DateManager::DateManager()
+  : journal_(nullptr),
+    bulk_loading_(false)
 {
 }
 
@@ -31,6 +36,8 @@ DateManager::~DateManager()
 ///////////////////////////////////////////////////////////////////////////////
 bool DateManager::add(int64_t date, int* id)
 {
+  JCCU_TRACE("DateManager::add");
+
   if(exists(date))
     return false;
 
@@ -59,11 +66,21 @@ bool DateManager::insert(int date_id, int64_t date)
 
   int new_row = dates_list_.size();
 
-  beginInsertRows(QModelIndex(), new_row, new_row);
-    fwd_dates_container_.insert(date_id, date);
-    rev_dates_container_.insert(date, date_id);
-    dates_list_.append(date);
-  endInsertRows();
+  if(!bulk_loading_)
+    beginInsertRows(QModelIndex(), new_row, new_row);
+
+  fwd_dates_container_.insert(date_id, date);
+  rev_dates_container_.insert(date, date_id);
+  dates_list_.append(date);
+  ids_.reserve(date_id);
+
+  if(!bulk_loading_) {
+    endInsertRows();
+    Metrics::Add(Metrics::RowsInserted);
+  }
+
+  if(journal_ && !bulk_loading_)
+    journal_->dateInserted(date_id, date);
 
   return true;
 }
@@ -74,6 +91,8 @@ bool DateManager::insert(int date_id, int64_t date)
 ///////////////////////////////////////////////////////////////////////////////
 bool DateManager::remove(int64_t date)
 {
+  JCCU_TRACE("DateManager::remove");
+
   if(!date)
     return false;
 
@@ -81,22 +100,108 @@ bool DateManager::remove(int64_t date)
     return false;
 
   int index = dates_list_.indexOf(date);
+  int date_id = id(date);
 
   beginRemoveRows(QModelIndex(), index, index);
-    fwd_dates_container_.remove(id(date));
+    fwd_dates_container_.remove(date_id);
     rev_dates_container_.remove(date);
     dates_list_.removeOne(date);
+    ids_.release(date_id);
   endRemoveRows();
 
+  Metrics::Add(Metrics::RowsRemoved);
+
+  if(journal_)
+    journal_->dateRemoved(date_id);
+
   return true;
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// Removes all of the dates with the given ids that exist, in one pass over
+/// the rows. A single run of rows is removed with one notification, and
+/// anything else with one reset; either way it's one journal record.
+/// Returns the number of dates removed.
+///////////////////////////////////////////////////////////////////////////////
+int DateManager::removeMany(const QList<int>& date_ids)
+{
+  JCCU_TRACE("DateManager::removeMany");
+
+  QSet<int64_t> dates;
+  QList<int> removed_ids;
+
+  auto it = date_ids.constBegin(),
+       end = date_ids.constEnd();
+
+  for(; it != end; ++it) {
+    if(!exists(*it) || dates.contains(date(*it)))
+      continue;
+
+    dates.insert(date(*it));
+    removed_ids.append(*it);
+  }
+
+  if(removed_ids.isEmpty())
+    return 0;
+
+  int first_row = -1;
+  int last_row = -1;
+
+  for(int i = 0; i < dates_list_.size(); ++i) {
+    if(!dates.contains(dates_list_.at(i)))
+      continue;
+
+    if(first_row < 0)
+      first_row = i;
+
+    last_row = i;
+  }
+
+  const bool one_run = last_row - first_row + 1 == removed_ids.size();
+
+  if(one_run)
+    beginRemoveRows(QModelIndex(), first_row, last_row);
+  else
+    beginResetModel();
+
+  int kept = first_row;
+
+  for(int i = first_row; i < dates_list_.size(); ++i)
+    if(!dates.contains(dates_list_.at(i)))
+      dates_list_[kept++] = dates_list_.at(i);
+
+  dates_list_.erase(dates_list_.begin() + kept, dates_list_.end());
+
+  auto id_it = removed_ids.constBegin(),
+       id_end = removed_ids.constEnd();
+
+  for(; id_it != id_end; ++id_it) {
+    rev_dates_container_.remove(fwd_dates_container_.take(*id_it));
+    ids_.release(*id_it);
+  }
+
+  if(one_run)
+    endRemoveRows();
+  else
+    endResetModel();
+
+  Metrics::Add(Metrics::RowsRemoved, removed_ids.size());
+
+  if(journal_)
+    journal_->datesRemoved(removed_ids);
+
+  return removed_ids.size();
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Clears all dates.
 ///////////////////////////////////////////////////////////////////////////////
 void DateManager::clear()
 {
+  JCCU_TRACE("DateManager::clear");
+
   const int size = dates_list_.size();
 
   if(!size)
@@ -106,7 +211,64 @@ void DateManager::clear()
     fwd_dates_container_.clear();
     rev_dates_container_.clear();
     dates_list_.clear();
+    ids_.clear();
   endRemoveRows();
+
+  Metrics::Add(Metrics::RowsRemoved, size);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Clears all dates and starts a bulk load.
+/// Until endBulkLoad, inserts emit nothing but a single reset.
+///////////////////////////////////////////////////////////////////////////////
+void DateManager::beginBulkLoad()
+{
+  clear();
+  beginResetModel();
+  bulk_loading_ = true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Ends the reset started by beginBulkLoad.
+///////////////////////////////////////////////////////////////////////////////
+void DateManager::endBulkLoad()
+{
+  JCCU_TRACE("DateManager::endBulkLoad");
+
+  if(!bulk_loading_)
+    return;
+
+  bulk_loading_ = false;
+  endResetModel();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Exchanges all dates with other's in a single reset.
+/// This is how dates loaded into a detached manager on another thread are
+/// taken over; other emits nothing. Neither may be bulk loading.
+///////////////////////////////////////////////////////////////////////////////
+void DateManager::swap(DateManager* other)
+{
+  JCCU_TRACE("DateManager::swap");
+
+  beginResetModel();
+  fwd_dates_container_.swap(other->fwd_dates_container_);
+  rev_dates_container_.swap(other->rev_dates_container_);
+  dates_list_.swap(other->dates_list_);
+  qSwap(ids_, other->ids_);
+  endResetModel();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets the journal that inserts and removals are recorded to, if any.
+///////////////////////////////////////////////////////////////////////////////
+void DateManager::setJournal(JournalManager* journal)
+{
+  journal_ = journal;
 }
 
 
@@ -115,6 +277,8 @@ void DateManager::clear()
 ///////////////////////////////////////////////////////////////////////////////
 QVariant DateManager::data(const QModelIndex& index, int role) const
 {
+  Metrics::AddDataCall(role);
+
   if(!index.isValid())
     return QVariant();
 
@@ -133,7 +297,7 @@ QVariant DateManager::data(const QModelIndex& index, int role) const
   if(index.column() == 0)
     return date_id;
   else
-    return date;
+    return static_cast<qint64>(date);
 }
 
 
@@ -198,12 +362,16 @@ bool DateManager::exists(int64_t date) const
 ///////////////////////////////////////////////////////////////////////////////
 int64_t DateManager::date(int date_id) const
 {
-  int64_t date = 0;
+  return fwd_dates_container_.value(date_id);
+}
 
-  if(exists(date_id))
-    date = fwd_dates_container_.value(date_id);
 
-  return date;
+///////////////////////////////////////////////////////////////////////////////
+/// Returns all dates by id.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, int64_t>& DateManager::dates() const
+{
+  return fwd_dates_container_;
 }
 
 
@@ -226,17 +394,7 @@ int DateManager::id(int64_t date) const
 ///////////////////////////////////////////////////////////////////////////////
 int DateManager::nextId() const
 {
-  auto date_ids = fwd_dates_container_.keys();
-  std::sort(date_ids.begin(), date_ids.end());
-
-  int i = 1;
-  const int size = date_ids.size();
-
-  for(; i <= size; ++i)
-    if(i < date_ids[i - 1])
-      break;
-
-  return i;
+  return ids_.next();
 }
 
 } // namespace jccu
\ No newline at end of file
@@ -9,10 +9,13 @@
 #include <QHash>
 #include <QList>
 #include <QObject>
+#include "id_allocator.h"
 
 namespace jccu
 {
 
+class JournalManager;
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Manages all dates.
 ///////////////////////////////////////////////////////////////////////////////
@@ -26,8 +29,15 @@ class DateManager : public QAbstractTableModel
     bool insert(int date_id, int64_t date);
     
     bool remove(int64_t date);
+    int removeMany(const QList<int>& date_ids);
     void clear();
 
+    void beginBulkLoad();
+    void endBulkLoad();
+    void swap(DateManager* other);
+
+    void setJournal(JournalManager* journal);
+
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
     QVariant headerData(int section,
                         Qt::Orientation orientation,
@@ -40,6 +50,7 @@ class DateManager : public QAbstractTableModel
     bool exists(int64_t date) const;
 
     int64_t date(int date_id) const;
+    const QHash<int, int64_t>& dates() const;
     int id(int64_t date) const;
     int nextId() const;
 
@@ -50,6 +61,9 @@ class DateManager : public QAbstractTableModel
     QHash<int, int64_t> fwd_dates_container_; // <DateId, Date>
     QHash<int64_t, int> rev_dates_container_; // <Date, DateId>
     QList<int64_t> dates_list_;               // <Date>
+    IdAllocator ids_;
+    JournalManager* journal_;
+    bool bulk_loading_;
 };
 
 } // namespace jccu
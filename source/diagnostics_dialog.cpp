@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "diagnostics_dialog.h"
+
+#include <QFont>
+#include <QPushButton>
+#include <QScrollBar>
+#include <QTimer>
+#include "metrics.h"
+#include "ui_DiagnosticsDialog.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+///////////////////////////////////////////////////////////////////////////////
+DiagnosticsDialog::DiagnosticsDialog(QWidget* parent)
+  : QDialog(parent),
+    ui_(new Ui::DiagnosticsDialog),
+    refresh_timer_(new QTimer(this))
+{
+  ui_->setupUi(this);
+
+  // The report is a table laid out with spaces.
+  QFont font("Courier");
+  font.setStyleHint(QFont::TypeWriter);
+  ui_->plainTextEdit->setFont(font);
+
+  auto reset_button = ui_->buttonBox->button(QDialogButtonBox::Reset);
+
+  connect(reset_button, &QPushButton::clicked, [this]() {
+    Metrics::Reset();
+    refresh();
+  });
+
+  connect(refresh_timer_, &QTimer::timeout, [this]() { refresh(); });
+  refresh_timer_->start(1000);
+
+  refresh();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+DiagnosticsDialog::~DiagnosticsDialog()
+{
+  delete ui_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Shows the current metrics, keeping the scroll position.
+///////////////////////////////////////////////////////////////////////////////
+void DiagnosticsDialog::refresh()
+{
+  auto scroll_bar = ui_->plainTextEdit->verticalScrollBar();
+  int position = scroll_bar->value();
+
+  ui_->plainTextEdit->setPlainText(Metrics::Report());
+  scroll_bar->setValue(position);
+}
+
+} // namespace jccu
@@ -0,0 +1,36 @@
+#ifndef JCCU_SOURCE_DIAGNOSTICS_DIALOG_H
+#define JCCU_SOURCE_DIAGNOSTICS_DIALOG_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QDialog>
+
+namespace Ui {class DiagnosticsDialog;}
+class QTimer;
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Diagnostics dialog. Shows the metrics, refreshed every second.
+///////////////////////////////////////////////////////////////////////////////
+class DiagnosticsDialog : public QDialog
+{
+  public:
+    explicit DiagnosticsDialog(QWidget* parent = nullptr);
+    ~DiagnosticsDialog();
+
+  private:
+    DiagnosticsDialog(const DiagnosticsDialog&);
+    DiagnosticsDialog& operator=(const DiagnosticsDialog&);
+
+    void refresh();
+
+    Ui::DiagnosticsDialog* ui_;
+    QTimer* refresh_timer_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_DIAGNOSTICS_DIALOG_H
@@ -5,6 +5,7 @@
 
 #include <QPushButton>
 #include "application.h"
+#include "good_completer.h"
 #include "good_manager.h"
 #include "ui_EditGoodDialog.h"
 
@@ -23,6 +24,7 @@ EditGoodDialog::EditGoodDialog(QWidget* parent)
   auto good_manager = Application::Instance()->goodManager();
   ui_->comboBox->setModel(good_manager);
   ui_->comboBox->setModelColumn(1);
+  new GoodCompleter(ui_->comboBox);
   ui_->buttonBox->button(QDialogButtonBox::Cancel)->setDefault(true);
 }
 
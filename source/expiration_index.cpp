@@ -0,0 +1,173 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "expiration_index.h"
+
+#include <algorithm>
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+///////////////////////////////////////////////////////////////////////////////
+ExpirationIndex::ExpirationIndex()
+  : total_(0)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+ExpirationIndex::~ExpirationIndex()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Adds count cans expiring on day. count may be negative.
+///////////////////////////////////////////////////////////////////////////////
+void ExpirationIndex::add(int64_t day, int count)
+{
+  if(!count)
+    return;
+
+  const int index = cover(day);
+  const int size = counts_.size();
+
+  counts_[index] += count;
+  total_ += count;
+
+  for(int i = index + 1; i <= size; i += i & -i)
+    tree_[i] += count;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Removes all counts.
+///////////////////////////////////////////////////////////////////////////////
+void ExpirationIndex::clear()
+{
+  days_.clear();
+  counts_.clear();
+  tree_.clear();
+  total_ = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of cans expiring on day.
+///////////////////////////////////////////////////////////////////////////////
+int ExpirationIndex::countOn(int64_t day) const
+{
+  auto it = std::lower_bound(days_.constBegin(), days_.constEnd(), day);
+
+  if(it == days_.constEnd() || *it != day)
+    return 0;
+
+  return counts_.at(it - days_.constBegin());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of cans expiring on or before day.
+///////////////////////////////////////////////////////////////////////////////
+int ExpirationIndex::countOnOrBefore(int64_t day) const
+{
+  auto it = std::upper_bound(days_.constBegin(), days_.constEnd(), day);
+
+  if(it == days_.constEnd())
+    return total_;
+
+  return prefixCount(it - days_.constBegin());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of cans counted.
+///////////////////////////////////////////////////////////////////////////////
+int ExpirationIndex::total() const
+{
+  return total_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the index of day in days_, adding it if it's new.
+/// A day after all the others is appended to the tree in O(log D), so
+/// adding days in order (as a bulk load does) stays cheap. Any other new
+/// day rebuilds the tree in O(D), dropping days left without cans at the
+/// same time, so D only counts days in use.
+///////////////////////////////////////////////////////////////////////////////
+int ExpirationIndex::cover(int64_t day)
+{
+  auto it = std::lower_bound(days_.constBegin(), days_.constEnd(), day);
+  int index = it - days_.constBegin();
+
+  if(it != days_.constEnd() && *it == day)
+    return index;
+
+  if(index == days_.size()) {
+    // The new node sums the days it covers before this one; its own is 0.
+    const int node = index + 1;
+
+    days_.append(day);
+    counts_.append(0);
+    tree_.resize(node);
+    tree_.append(prefixCount(index) - prefixCount(node - (node & -node)));
+    return index;
+  }
+
+  days_.insert(index, day);
+  counts_.insert(index, 0);
+
+  const int old_size = days_.size();
+  int size = 0;
+  int new_index = 0;
+
+  for(int i = 0; i < old_size; ++i) {
+    if(!counts_.at(i) && i != index)
+      continue;
+
+    if(i == index)
+      new_index = size;
+
+    days_[size] = days_.at(i);
+    counts_[size] = counts_.at(i);
+    ++size;
+  }
+
+  days_.resize(size);
+  counts_.resize(size);
+
+  // Linear-time Fenwick build.
+  tree_.fill(0, size + 1);
+
+  for(int i = 1; i <= size; ++i) {
+    tree_[i] += counts_.at(i - 1);
+
+    int parent = i + (i & -i);
+
+    if(parent <= size)
+      tree_[parent] += tree_.at(i);
+  }
+
+  return new_index;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of cans expiring on the first size days.
+///////////////////////////////////////////////////////////////////////////////
+int ExpirationIndex::prefixCount(int size) const
+{
+  int count = 0;
+
+  for(int i = size; i > 0; i -= i & -i)
+    count += tree_.at(i);
+
+  return count;
+}
+
+} // namespace jccu
@@ -0,0 +1,45 @@
+#ifndef JCCU_SOURCE_EXPIRATION_INDEX_H
+#define JCCU_SOURCE_EXPIRATION_INDEX_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <stdint.h>
+#include <QVector>
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Counts cans per expiration day (Julian day).
+/// A Fenwick tree over the days that have cans, in order, answers "how many
+/// cans expire on or before day X" in O(log D), where D is the number of
+/// those days. Only days in use take space, so an outlier date far from the
+/// rest costs no more than any other.
+///////////////////////////////////////////////////////////////////////////////
+class ExpirationIndex
+{
+  public:
+    ExpirationIndex();
+    ~ExpirationIndex();
+
+    void add(int64_t day, int count = 1);
+    void clear();
+
+    int countOn(int64_t day) const;
+    int countOnOrBefore(int64_t day) const;
+    int total() const;
+
+  private:
+    int cover(int64_t day);
+    int prefixCount(int size) const;
+
+    QVector<int64_t> days_; // <Day>, ascending.
+    QVector<int> counts_;   // <Count>, by index into days_.
+    QVector<int> tree_;     // Fenwick tree over counts_, 1-based.
+    int total_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_EXPIRATION_INDEX_H
@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "good_completer.h"
+
+#include <QComboBox>
+#include <QLineEdit>
+#include <QList>
+#include <QStringList>
+#include <QStringListModel>
+#include "application.h"
+#include "good_manager.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor. The completer is owned by combo_box.
+///////////////////////////////////////////////////////////////////////////////
+GoodCompleter::GoodCompleter(QComboBox* combo_box)
+  : QCompleter(combo_box),
+    combo_box_(combo_box),
+    goods_model_(new QStringListModel(this))
+{
+  // The search has already ranked and filtered the goods.
+  setModel(goods_model_);
+  setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+
+  // Typing mustn't add goods; that's what the add good button is for.
+  combo_box_->setEditable(true);
+  combo_box_->setInsertPolicy(QComboBox::NoInsert);
+  combo_box_->setCompleter(this);
+
+  connect(combo_box_->lineEdit(), &QLineEdit::textEdited,
+          [this](const QString& text) { update(text); });
+
+  // The combo box picks the row of the completion in goods_model_, which
+  // isn't the row of the good in its own model. Pick the good instead.
+  connect(this,
+          static_cast<void (QCompleter::*)(const QString&)>(
+            &QCompleter::activated),
+          [this](const QString& good) {
+    combo_box_->setCurrentIndex(combo_box_->findText(good));
+  });
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+GoodCompleter::~GoodCompleter()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Offers the goods that best match text.
+///////////////////////////////////////////////////////////////////////////////
+void GoodCompleter::update(const QString& text)
+{
+  auto good_manager = Application::Instance()->goodManager();
+  QList<int> good_ids = good_manager->search(text);
+  QStringList goods;
+
+  auto it = good_ids.constBegin(),
+       end = good_ids.constEnd();
+
+  for(; it != end; ++it)
+    goods.append(good_manager->good(*it));
+
+  goods_model_->setStringList(goods);
+}
+
+} // namespace jccu
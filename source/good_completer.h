@@ -0,0 +1,39 @@
+#ifndef JCCU_SOURCE_GOOD_COMPLETER_H
+#define JCCU_SOURCE_GOOD_COMPLETER_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QCompleter>
+#include <QString>
+
+class QComboBox;
+class QStringListModel;
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Completes good names in a good combo box.
+/// Makes the combo box editable and, as the user types, offers the goods
+/// GoodManager::search ranks best for the text, typos and all.
+///////////////////////////////////////////////////////////////////////////////
+class GoodCompleter : public QCompleter
+{
+  public:
+    explicit GoodCompleter(QComboBox* combo_box);
+    ~GoodCompleter();
+
+  private:
+    GoodCompleter(const GoodCompleter&);
+    GoodCompleter& operator=(const GoodCompleter&);
+
+    void update(const QString& text);
+
+    QComboBox* combo_box_;
+    QStringListModel* goods_model_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_GOOD_COMPLETER_H
@@ -0,0 +1,362 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "good_index.h"
+
+#include <algorithm>
+
+namespace jccu
+{
+
+const double GoodIndex::SearchScore = 0.3;
+const double GoodIndex::SimilarScore = 0.6;
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+///////////////////////////////////////////////////////////////////////////////
+GoodIndex::GoodIndex()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+GoodIndex::~GoodIndex()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Indexes good under good_id. good_id must not already be indexed.
+///////////////////////////////////////////////////////////////////////////////
+void GoodIndex::add(int good_id, const QString& good)
+{
+  QString folded = Fold(good);
+  QVector<Trigram> trigrams = Trigrams(folded, true);
+
+  auto it = trigrams.constBegin(),
+       end = trigrams.constEnd();
+
+  for(; it != end; ++it)
+    trigrams_container_[*it].append(good_id);
+
+  folded_container_.insert(good_id, folded);
+  sizes_container_.insert(good_id, trigrams.size());
+  prefix_container_.insert(folded, good_id);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Removes good_id from the index, if it's indexed.
+///////////////////////////////////////////////////////////////////////////////
+void GoodIndex::remove(int good_id)
+{
+  if(!folded_container_.contains(good_id))
+    return;
+
+  QString folded = folded_container_.take(good_id);
+  QVector<Trigram> trigrams = Trigrams(folded, true);
+
+  auto it = trigrams.constBegin(),
+       end = trigrams.constEnd();
+
+  // Order within a trigram's goods doesn't matter; swap with the last.
+  for(; it != end; ++it) {
+    auto goods_it = trigrams_container_.find(*it);
+    QVector<int>& good_ids = *goods_it;
+    int i = good_ids.indexOf(good_id);
+
+    good_ids[i] = good_ids.last();
+    good_ids.removeLast();
+
+    if(good_ids.isEmpty())
+      trigrams_container_.erase(goods_it);
+  }
+
+  sizes_container_.remove(good_id);
+  prefix_container_.remove(folded, good_id);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Removes everything from the index.
+///////////////////////////////////////////////////////////////////////////////
+void GoodIndex::clear()
+{
+  trigrams_container_.clear();
+  folded_container_.clear();
+  sizes_container_.clear();
+  prefix_container_.clear();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns up to limit good ids matching query, best first.
+/// Goods come in tiers: the good the query names, then goods starting with
+/// the query, then goods with a word starting with the query give or take a
+/// typo per four letters (two at most), then goods that only share enough
+/// trigrams with it. Within a tier, fewer typos and then more trigrams in
+/// common rank higher; ties go alphabetically.
+///////////////////////////////////////////////////////////////////////////////
+QList<int> GoodIndex::search(const QString& query, int limit) const
+{
+  QString folded = Fold(query);
+
+  if(folded.isEmpty() || limit < 1)
+    return QList<int>();
+
+  const int max_distance = qMin(2, folded.size() / 4);
+
+  // The query may be half typed, so its end isn't padded.
+  QVector<Trigram> trigrams = Trigrams(folded, false);
+  QHash<int, int> shared = sharedTrigrams(trigrams);
+  QHash<int, double> scores; // <GoodId, Score>
+
+  // A typo spoils at most three trigrams, so goods missing more than that
+  // per allowed typo can't be within max_distance.
+  const int min_shared = trigrams.size() - 3 * max_distance;
+
+  auto it = shared.constBegin(),
+       end = shared.constEnd();
+
+  for(; it != end; ++it) {
+    double score = dice(it.key(), it.value(), trigrams.size());
+    int distance = max_distance + 1;
+
+    if(it.value() >= min_shared)
+      distance = WordDistance(folded,
+                              folded_container_.value(it.key()),
+                              max_distance);
+
+    if(distance <= max_distance)
+      scores.insert(it.key(), 10 + score - distance);
+    else if(score >= SearchScore)
+      scores.insert(it.key(), score);
+  }
+
+  auto prefix_it = prefix_container_.lowerBound(folded),
+       prefix_end = prefix_container_.constEnd();
+
+  for(; prefix_it != prefix_end; ++prefix_it) {
+    if(!prefix_it.key().startsWith(folded))
+      break;
+
+    int good_id = prefix_it.value();
+    double tier = prefix_it.key() == folded ? 30 : 20;
+    double score = dice(good_id, shared.value(good_id), trigrams.size());
+
+    scores.insert(good_id, tier + score);
+  }
+
+  return rank(scores, limit);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the ids of goods that look like near-duplicates of good, most
+/// alike first: goods that fold to the same name, then goods that share
+/// most of their trigrams with it.
+///////////////////////////////////////////////////////////////////////////////
+QList<int> GoodIndex::similar(const QString& good) const
+{
+  QString folded = Fold(good);
+
+  if(folded.isEmpty())
+    return QList<int>();
+
+  QVector<Trigram> trigrams = Trigrams(folded, true);
+  QHash<int, int> shared = sharedTrigrams(trigrams);
+  QHash<int, double> scores; // <GoodId, Score>
+
+  auto it = shared.constBegin(),
+       end = shared.constEnd();
+
+  for(; it != end; ++it) {
+    double score = dice(it.key(), it.value(), trigrams.size());
+
+    if(score >= SimilarScore)
+      scores.insert(it.key(), score);
+  }
+
+  QList<int> same_ids = prefix_container_.values(folded);
+
+  for(int i = 0; i < same_ids.size(); ++i)
+    scores[same_ids.at(i)] = 2.0;
+
+  return rank(scores, scores.size());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns good case folded, with whitespace trimmed and runs of it
+/// collapsed to single spaces.
+///////////////////////////////////////////////////////////////////////////////
+QString GoodIndex::Fold(const QString& good)
+{
+  return good.toCaseFolded().simplified();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the distinct trigrams of folded, sorted. The start is padded with
+/// a space so word starts are weighted, and so is the end if pad_end is set.
+///////////////////////////////////////////////////////////////////////////////
+QVector<GoodIndex::Trigram> GoodIndex::Trigrams(const QString& folded,
+                                                bool pad_end)
+{
+  QString padded = " " + folded;
+
+  if(pad_end)
+    padded += " ";
+
+  QVector<Trigram> trigrams;
+
+  if(padded.size() < 3)
+    return trigrams;
+
+  trigrams.reserve(padded.size() - 2);
+
+  for(int i = 0; i + 2 < padded.size(); ++i)
+    trigrams.append(Trigram(padded.at(i).unicode()) << 32 |
+                    Trigram(padded.at(i + 1).unicode()) << 16 |
+                    Trigram(padded.at(i + 2).unicode()));
+
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                 trigrams.end());
+
+  return trigrams;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the fewest typos (letters added, dropped or changed) that turn
+/// query into the start of one of folded's words, or into the start of a
+/// run of them. Gives up as soon as that's more than max_distance, and
+/// returns max_distance + 1.
+///////////////////////////////////////////////////////////////////////////////
+int GoodIndex::WordDistance(const QString& query,
+                            const QString& folded,
+                            int max_distance)
+{
+  const int size = folded.size();
+  const int too_far = max_distance + 1;
+
+  // Edit distances from the query so far to the text ending at each column.
+  // Matches may only start at a word, and may end anywhere.
+  QVector<int> previous(size + 1);
+  QVector<int> current(size + 1);
+
+  for(int j = 0; j <= size; ++j)
+    previous[j] = (j == 0 || folded.at(j - 1) == ' ') ? 0 : too_far;
+
+  for(int i = 1; i <= query.size(); ++i) {
+    current[0] = qMin(i, too_far);
+    int row_best = current[0];
+
+    for(int j = 1; j <= size; ++j) {
+      int changed = previous[j - 1] + (query.at(i - 1) != folded.at(j - 1));
+      int dropped = previous[j] + 1;
+      int added = current[j - 1] + 1;
+
+      current[j] = qMin(qMin(changed, dropped), qMin(added, too_far));
+      row_best = qMin(row_best, current[j]);
+    }
+
+    if(row_best >= too_far)
+      return too_far;
+
+    previous.swap(current);
+  }
+
+  int best = too_far;
+
+  for(int j = 0; j <= size; ++j)
+    best = qMin(best, previous.at(j));
+
+  return best;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns how many of the given trigrams each good has, for the goods that
+/// have any.
+///////////////////////////////////////////////////////////////////////////////
+QHash<int, int> GoodIndex::sharedTrigrams(
+  const QVector<Trigram>& trigrams) const
+{
+  QHash<int, int> shared; // <GoodId, Trigrams in common>
+
+  auto trigram_it = trigrams.constBegin(),
+       trigram_end = trigrams.constEnd();
+
+  for(; trigram_it != trigram_end; ++trigram_it) {
+    auto goods_it = trigrams_container_.constFind(*trigram_it);
+
+    if(goods_it == trigrams_container_.constEnd())
+      continue;
+
+    auto id_it = goods_it->constBegin(),
+         id_end = goods_it->constEnd();
+
+    for(; id_it != id_end; ++id_it)
+      ++shared[*id_it];
+  }
+
+  return shared;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns Dice's coefficient of good_id's trigrams and a set of count
+/// trigrams it shares shared of: 1 when they're the same, 0 when they have
+/// none in common.
+///////////////////////////////////////////////////////////////////////////////
+double GoodIndex::dice(int good_id, int shared, int count) const
+{
+  return 2.0 * shared / (count + sizes_container_.value(good_id));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns up to limit of the scored good ids, highest score first, then
+/// alphabetically by folded name, then by id.
+///////////////////////////////////////////////////////////////////////////////
+QList<int> GoodIndex::rank(const QHash<int, double>& scores, int limit) const
+{
+  QVector<int> good_ids;
+  good_ids.reserve(scores.size());
+
+  auto it = scores.constBegin(),
+       end = scores.constEnd();
+
+  for(; it != end; ++it)
+    good_ids.append(it.key());
+
+  auto Compare = [&](int good_id_a, int good_id_b) -> bool {
+    double score_a = scores.value(good_id_a);
+    double score_b = scores.value(good_id_b);
+
+    if(score_a != score_b)
+      return score_a > score_b;
+
+    int order = QString::compare(folded_container_.value(good_id_a),
+                                 folded_container_.value(good_id_b));
+
+    if(order != 0)
+      return order < 0;
+
+    return good_id_a < good_id_b;
+  };
+
+  const int count = qMin(limit, good_ids.size());
+
+  std::partial_sort(good_ids.begin(), good_ids.begin() + count,
+                    good_ids.end(), Compare);
+
+  return good_ids.mid(0, count).toList();
+}
+
+} // namespace jccu
@@ -0,0 +1,62 @@
+#ifndef JCCU_SOURCE_GOOD_INDEX_H
+#define JCCU_SOURCE_GOOD_INDEX_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Fuzzy search over good names.
+/// Names are case folded with whitespace simplified, so "Corn" and "corn "
+/// fold to the same name. Folded names are kept sorted for prefix matches,
+/// and each trigram of a folded name maps to the goods that contain it, so
+/// misspelled queries still find goods that share most of their trigrams.
+///////////////////////////////////////////////////////////////////////////////
+class GoodIndex
+{
+  public:
+    GoodIndex();
+    ~GoodIndex();
+
+    void add(int good_id, const QString& good);
+    void remove(int good_id);
+    void clear();
+
+    QList<int> search(const QString& query, int limit) const;
+    QList<int> similar(const QString& good) const;
+
+    static QString Fold(const QString& good);
+
+  private:
+    typedef quint64 Trigram; // Three UTF-16 code units.
+
+    static QVector<Trigram> Trigrams(const QString& folded, bool pad_end);
+    static int WordDistance(const QString& query,
+                            const QString& folded,
+                            int max_distance);
+
+    QHash<int, int> sharedTrigrams(const QVector<Trigram>& trigrams) const;
+    double dice(int good_id, int shared, int count) const;
+    QList<int> rank(const QHash<int, double>& scores, int limit) const;
+
+    static const double SearchScore;  // Least trigram score search returns
+                                      // for goods with too many typos.
+    static const double SimilarScore; // Least trigram score similar returns.
+
+    QHash<Trigram, QVector<int> > trigrams_container_; // <Trigram, GoodIds>
+    QHash<int, QString> folded_container_;             // <GoodId, Folded>
+    QHash<int, int> sizes_container_;                  // <GoodId, Trigrams>
+    QMultiMap<QString, int> prefix_container_;         // <Folded, GoodId>
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_GOOD_INDEX_H
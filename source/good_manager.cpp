@@ -4,6 +4,9 @@
 #include "good_manager.h"
 
 #include <algorithm>
+#include "journal_manager.h"
+#include "metrics.h"
+#include "trace.h"
 
 namespace jccu
 {
@@ -12,7 +15,10 @@ namespace jccu
 /// Constructor.
 ///////////////////////////////////////////////////////////////////////////////
 GoodManager::GoodManager()
+  : journal_(nullptr),
+    bulk_loading_(false)
 {
+  collator_.setCaseSensitivity(Qt::CaseInsensitive);
 }
 
 
@@ -31,6 +37,8 @@ GoodManager::~GoodManager()
 ///////////////////////////////////////////////////////////////////////////////
 bool GoodManager::add(const QString& good, int* id)
 {
+  JCCU_TRACE("GoodManager::add");
+
   if(exists(good))
     return false;
 
@@ -45,6 +53,7 @@ bool GoodManager::add(const QString& good, int* id)
 
 ///////////////////////////////////////////////////////////////////////////////
 /// Inserts good good with id good_id, if neither exists and good_id > 0.
+/// During a bulk load the good is appended; it's sorted in endBulkLoad.
 ///////////////////////////////////////////////////////////////////////////////
 bool GoodManager::insert(int good_id, const QString& good)
 {
@@ -57,15 +66,52 @@ bool GoodManager::insert(int good_id, const QString& good)
   if(exists(good_id) || exists(good))
     return false;
 
-  int new_row = goods_list_.size();
-  
+  // The sort key is built once here; sorting never touches the strings.
+  auto sort_key = collator_.sortKey(good);
+
+  if(bulk_loading_) {
+    fwd_goods_container_.insert(good_id, good);
+    rev_goods_container_.insert(good, good_id);
+    goods_list_.append(good_id);
+    sort_keys_list_.append(sort_key);
+    search_index_.add(good_id, good);
+    ids_.reserve(good_id);
+    return true;
+  }
+
+  JCCU_TRACE("GoodManager::insert");
+
+  // Equal keys (e.g. "Corn" and "corn") fall back to id order.
+  int first = 0;
+  int last = goods_list_.size();
+
+  while(first < last) {
+    int middle = first + (last - first) / 2;
+    int order = sort_keys_list_.at(middle).compare(sort_key);
+
+    if(order < 0 || (order == 0 && goods_list_.at(middle) < good_id))
+      first = middle + 1;
+    else
+      last = middle;
+  }
+
+  int new_row = first;
+
   beginInsertRows(QModelIndex(), new_row, new_row);
     fwd_goods_container_.insert(good_id, good);
     rev_goods_container_.insert(good, good_id);
-    goods_list_.append(good);
+    goods_list_.insert(new_row, good_id);
+    sort_keys_list_.insert(new_row, sort_key);
+    search_index_.add(good_id, good);
+    ids_.reserve(good_id);
+    reindexRows(new_row);
   endInsertRows();
-  
-  sort();
+
+  Metrics::Add(Metrics::RowsInserted);
+
+  if(journal_)
+    journal_->goodInserted(good_id, good);
+
   return true;
 }
 
@@ -75,17 +121,30 @@ bool GoodManager::insert(int good_id, const QString& good)
 ///////////////////////////////////////////////////////////////////////////////
 bool GoodManager::remove(const QString& good)
 {
+  JCCU_TRACE("GoodManager::remove");
+
   if(!exists(good))
     return false;
 
-  int index = goods_list_.indexOf(good);
+  int good_id = id(good);
+  int index = rank(good_id);
 
   beginRemoveRows(QModelIndex(), index, index);
-    fwd_goods_container_.remove(id(good));
+    fwd_goods_container_.remove(good_id);
     rev_goods_container_.remove(good);
-    goods_list_.removeOne(good);
+    goods_rows_container_.remove(good_id);
+    goods_list_.removeAt(index);
+    sort_keys_list_.removeAt(index);
+    search_index_.remove(good_id);
+    ids_.release(good_id);
+    reindexRows(index);
   endRemoveRows();
 
+  Metrics::Add(Metrics::RowsRemoved);
+
+  if(journal_)
+    journal_->goodRemoved(good_id);
+
   return true;
 }
 
@@ -95,6 +154,8 @@ bool GoodManager::remove(const QString& good)
 ///////////////////////////////////////////////////////////////////////////////
 void GoodManager::clear()
 {
+  JCCU_TRACE("GoodManager::clear");
+
   const int size = goods_list_.size();
 
   if(!size)
@@ -103,8 +164,86 @@ void GoodManager::clear()
   beginRemoveRows(QModelIndex(), 0, size - 1);
     fwd_goods_container_.clear();
     rev_goods_container_.clear();
+    goods_rows_container_.clear();
     goods_list_.clear();
+    sort_keys_list_.clear();
+    search_index_.clear();
+    ids_.clear();
   endRemoveRows();
+
+  Metrics::Add(Metrics::RowsRemoved, size);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Clears all goods and starts a bulk load.
+/// Until endBulkLoad, insert only appends and the model emits nothing but a
+/// single reset. Nothing else may be called in between.
+///////////////////////////////////////////////////////////////////////////////
+void GoodManager::beginBulkLoad()
+{
+  clear();
+  beginResetModel();
+  bulk_loading_ = true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sorts the goods inserted since beginBulkLoad and ends the reset.
+///////////////////////////////////////////////////////////////////////////////
+void GoodManager::endBulkLoad()
+{
+  JCCU_TRACE("GoodManager::endBulkLoad");
+
+  if(!bulk_loading_)
+    return;
+
+  const int size = goods_list_.size();
+  QList<int> rows;
+  rows.reserve(size);
+
+  for(int i = 0; i < size; ++i)
+    rows.append(i);
+
+  auto Compare = [this](int row_a, int row_b) -> bool {
+    return rowLessThan(row_a, row_b);
+  };
+
+  std::sort(rows.begin(), rows.end(), Compare);
+  reorderRows(rows);
+
+  bulk_loading_ = false;
+  endResetModel();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Exchanges all goods with other's in a single reset.
+/// This is how goods loaded into a detached manager on another thread are
+/// taken over; other emits nothing. Neither may be bulk loading.
+///////////////////////////////////////////////////////////////////////////////
+void GoodManager::swap(GoodManager* other)
+{
+  JCCU_TRACE("GoodManager::swap");
+
+  beginResetModel();
+  fwd_goods_container_.swap(other->fwd_goods_container_);
+  rev_goods_container_.swap(other->rev_goods_container_);
+  goods_rows_container_.swap(other->goods_rows_container_);
+  goods_list_.swap(other->goods_list_);
+  sort_keys_list_.swap(other->sort_keys_list_);
+  qSwap(search_index_, other->search_index_);
+  qSwap(ids_, other->ids_);
+  endResetModel();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets the journal that inserts and removals are recorded to, if any.
+///////////////////////////////////////////////////////////////////////////////
+void GoodManager::setJournal(JournalManager* journal)
+{
+  journal_ = journal;
 }
 
 
@@ -113,6 +252,8 @@ void GoodManager::clear()
 ///////////////////////////////////////////////////////////////////////////////
 QVariant GoodManager::data(const QModelIndex& index, int role) const
 {
+  Metrics::AddDataCall(role);
+
   if(!index.isValid())
     return QVariant();
 
@@ -125,13 +266,12 @@ QVariant GoodManager::data(const QModelIndex& index, int role) const
   if(index.row() >= goods_list_.size())
     return QVariant();
 
-  QString good = goods_list_.at(index.row());
-  int good_id = id(good);
+  int good_id = goods_list_.at(index.row());
 
   if(index.column() == 0)
     return good_id;
   else
-    return good;
+    return fwd_goods_container_.value(good_id);
 }
 
 
@@ -174,18 +314,54 @@ int GoodManager::rowCount(const QModelIndex& parent) const
 
 
 ///////////////////////////////////////////////////////////////////////////////
-/// Sorts alphabetically, ascending.
+/// Sorts alphabetically, ascending, ignoring case.
+/// Rows are kept in this order as goods are inserted, so this only has work
+/// to do if the order was disturbed. Persistent indexes follow their goods.
 ///////////////////////////////////////////////////////////////////////////////
 void GoodManager::sort(int column, Qt::SortOrder order)
 {
-  // Case insensitive compare.
-  auto Compare = [](const QString& a, const QString& b) -> bool {
-    QString ins_a = a.toLower(),
-            ins_b = b.toLower();
-    return ins_a < ins_b;
+  JCCU_TRACE("GoodManager::sort");
+  LatencyTimer timer(Metrics::Sort);
+  Metrics::Add(Metrics::Sorts);
+
+  const int size = goods_list_.size();
+  QList<int> rows;
+  rows.reserve(size);
+
+  for(int i = 0; i < size; ++i)
+    rows.append(i);
+
+  // Compares the cached sort keys; no strings are built while sorting.
+  auto Compare = [this](int row_a, int row_b) -> bool {
+    return rowLessThan(row_a, row_b);
   };
 
-  std::sort(goods_list_.begin(), goods_list_.end(), Compare);
+  if(std::is_sorted(rows.begin(), rows.end(), Compare))
+    return;
+
+  emit layoutAboutToBeChanged();
+
+  std::sort(rows.begin(), rows.end(), Compare);
+  reorderRows(rows);
+
+  // rows maps new rows to old ones; persistent indexes need the reverse.
+  QList<int> new_rows = rows;
+
+  for(int i = 0; i < size; ++i)
+    new_rows[rows.at(i)] = i;
+
+  auto old_indexes = persistentIndexList();
+  QModelIndexList new_indexes;
+  new_indexes.reserve(old_indexes.size());
+
+  auto it = old_indexes.constBegin(),
+       end = old_indexes.constEnd();
+
+  for(; it != end; ++it)
+    new_indexes.append(index(new_rows.at(it->row()), it->column()));
+
+  changePersistentIndexList(old_indexes, new_indexes);
+  emit layoutChanged();
 }
 
 
@@ -212,12 +388,16 @@ bool GoodManager::exists(const QString& good) const
 ///////////////////////////////////////////////////////////////////////////////
 QString GoodManager::good(int good_id) const
 {
-  QString good;
+  return fwd_goods_container_.value(good_id);
+}
 
-  if(exists(good_id))
-    good = fwd_goods_container_.value(good_id);
 
-  return good;
+///////////////////////////////////////////////////////////////////////////////
+/// Returns all goods by id.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, QString>& GoodManager::goods() const
+{
+  return fwd_goods_container_;
 }
 
 
@@ -235,22 +415,96 @@ int GoodManager::id(const QString& good) const
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the good's position in sorted order, or -1 if it doesn't exist.
+/// Comparing ranks orders goods the same way sort() does.
+///////////////////////////////////////////////////////////////////////////////
+int GoodManager::rank(int good_id) const
+{
+  return goods_rows_container_.value(good_id, -1);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Returns the smallest available good id.
 ///////////////////////////////////////////////////////////////////////////////
 int GoodManager::nextId() const
 {
-  auto good_ids = fwd_goods_container_.keys();
-  std::sort(good_ids.begin(), good_ids.end());
+  return ids_.next();
+}
 
-  int i = 1;
-  const int size = good_ids.size();
 
-  for(; i <= size; ++i)
-    if(i < good_ids[i - 1])
-      break;
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the ids of up to limit goods matching query, best first.
+/// Matching ignores case and extra whitespace, and tolerates typos.
+///////////////////////////////////////////////////////////////////////////////
+QList<int> GoodManager::search(const QString& query, int limit) const
+{
+  JCCU_TRACE("GoodManager::search");
+
+  return search_index_.search(query, limit);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the ids of goods that look like near-duplicates of good, most
+/// alike first. Differing only in case or whitespace counts, as do small
+/// misspellings.
+///////////////////////////////////////////////////////////////////////////////
+QList<int> GoodManager::similar(const QString& good) const
+{
+  JCCU_TRACE("GoodManager::similar");
+
+  return search_index_.similar(good);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if the good in row a sorts before the good in row b.
+/// Compares the cached sort keys, falling back to id order.
+///////////////////////////////////////////////////////////////////////////////
+bool GoodManager::rowLessThan(int row_a, int row_b) const
+{
+  int order = sort_keys_list_.at(row_a).compare(sort_keys_list_.at(row_b));
+
+  if(order != 0)
+    return order < 0;
+
+  return goods_list_.at(row_a) < goods_list_.at(row_b);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Rearranges the goods so that new row i holds what was in row rows[i].
+///////////////////////////////////////////////////////////////////////////////
+void GoodManager::reorderRows(const QList<int>& rows)
+{
+  const int size = rows.size();
+  QList<int> goods_list;
+  QList<QCollatorSortKey> sort_keys_list;
+  goods_list.reserve(size);
+  sort_keys_list.reserve(size);
+
+  for(int i = 0; i < size; ++i) {
+    goods_list.append(goods_list_.at(rows.at(i)));
+    sort_keys_list.append(sort_keys_list_.at(rows.at(i)));
+  }
+
+  goods_list_ = goods_list;
+  sort_keys_list_ = sort_keys_list;
+  reindexRows(0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Updates the stored row of every good from first_row onwards.
+///////////////////////////////////////////////////////////////////////////////
+void GoodManager::reindexRows(int first_row)
+{
+  const int size = goods_list_.size();
 
-  return i;
+  for(int i = first_row; i < size; ++i)
+    goods_rows_container_[goods_list_.at(i)] = i;
 }
 
 } // namespace jccu
\ No newline at end of file
@@ -5,13 +5,19 @@
 /// Includes
 ///////////////////////////////////////////////////////////////////////////////
 #include <QAbstractTableModel>
+#include <QCollator>
+#include <QCollatorSortKey>
 #include <QHash>
 #include <QList>
 #include <QString>
+#include "good_index.h"
+#include "id_allocator.h"
 
 namespace jccu
 {
 
+class JournalManager;
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Manages all goods.
 ///////////////////////////////////////////////////////////////////////////////
@@ -27,6 +33,12 @@ class GoodManager : public QAbstractTableModel
     bool remove(const QString& good);
     void clear();
 
+    void beginBulkLoad();
+    void endBulkLoad();
+    void swap(GoodManager* other);
+
+    void setJournal(JournalManager* journal);
+
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
     QVariant headerData(int section,
                         Qt::Orientation orientation,
@@ -41,16 +53,32 @@ class GoodManager : public QAbstractTableModel
     bool exists(const QString& good) const;
 
     QString good(int good_id) const;
+    const QHash<int, QString>& goods() const;
     int id(const QString& good) const;
+    int rank(int good_id) const;
     int nextId() const;
 
+    QList<int> search(const QString& query, int limit = 10) const;
+    QList<int> similar(const QString& good) const;
+
   private:
     GoodManager(const GoodManager&);
     GoodManager& operator=(const GoodManager&);
 
-    QHash<int, QString> fwd_goods_container_;
-    QHash<QString, int> rev_goods_container_;
-    QList<QString> goods_list_;
+    bool rowLessThan(int row_a, int row_b) const;
+    void reorderRows(const QList<int>& rows);
+    void reindexRows(int first_row);
+
+    QHash<int, QString> fwd_goods_container_;     // <GoodId, Good>
+    QHash<QString, int> rev_goods_container_;     // <Good, GoodId>
+    QHash<int, int> goods_rows_container_;        // <GoodId, Row>
+    QList<int> goods_list_;                       // <GoodId>
+    QList<QCollatorSortKey> sort_keys_list_;      // Parallel to goods_list_.
+    QCollator collator_;
+    GoodIndex search_index_;
+    IdAllocator ids_;
+    JournalManager* journal_;
+    bool bulk_loading_;
 };
 
 } // namespace jccu
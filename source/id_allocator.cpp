@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "id_allocator.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+///////////////////////////////////////////////////////////////////////////////
+IdAllocator::IdAllocator()
+  : top_(0)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+IdAllocator::~IdAllocator()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Marks id as used.
+/// Returns false if id is < 1 or already used.
+///////////////////////////////////////////////////////////////////////////////
+bool IdAllocator::reserve(int id)
+{
+  if(id < 1)
+    return false;
+
+  // Everything between the old top and id becomes a gap.
+  if(id > top_) {
+    if(id > top_ + 1)
+      free_ranges_.insert(top_ + 1, id - 1);
+
+    top_ = id;
+    return true;
+  }
+
+  auto it = free_ranges_.upperBound(id);
+
+  if(it == free_ranges_.begin())
+    return false;
+
+  --it;
+
+  int first = it.key();
+  int last = it.value();
+
+  if(last < id)
+    return false;
+
+  // Split the range around id.
+  free_ranges_.erase(it);
+
+  if(first < id)
+    free_ranges_.insert(first, id - 1);
+
+  if(id < last)
+    free_ranges_.insert(id + 1, last);
+
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Marks id as free.
+/// Returns false if id wasn't used.
+///////////////////////////////////////////////////////////////////////////////
+bool IdAllocator::release(int id)
+{
+  if(!used(id))
+    return false;
+
+  // Lower the top, swallowing the gap right below it.
+  if(id == top_) {
+    top_ = id - 1;
+
+    if(!free_ranges_.isEmpty()) {
+      auto last_range = --free_ranges_.end();
+
+      if(last_range.value() == top_) {
+        top_ = last_range.key() - 1;
+        free_ranges_.erase(last_range);
+      }
+    }
+
+    return true;
+  }
+
+  int first = id;
+  int last = id;
+
+  // Merge with the gap right after id.
+  auto next_range = free_ranges_.find(id + 1);
+
+  if(next_range != free_ranges_.end()) {
+    last = next_range.value();
+    free_ranges_.erase(next_range);
+  }
+
+  // Merge with the gap right before id.
+  auto prev_range = free_ranges_.lowerBound(id);
+
+  if(prev_range != free_ranges_.begin()) {
+    --prev_range;
+
+    if(prev_range.value() == id - 1) {
+      prev_range.value() = last;
+      return true;
+    }
+  }
+
+  free_ranges_.insert(first, last);
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Frees every id.
+///////////////////////////////////////////////////////////////////////////////
+void IdAllocator::clear()
+{
+  free_ranges_.clear();
+  top_ = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if id is in use.
+///////////////////////////////////////////////////////////////////////////////
+bool IdAllocator::used(int id) const
+{
+  if(id < 1 || id > top_)
+    return false;
+
+  auto it = free_ranges_.upperBound(id);
+
+  if(it == free_ranges_.constBegin())
+    return true;
+
+  --it;
+  return it.value() < id;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the smallest free id.
+///////////////////////////////////////////////////////////////////////////////
+int IdAllocator::next() const
+{
+  if(free_ranges_.isEmpty())
+    return top_ + 1;
+
+  return free_ranges_.firstKey();
+}
+
+} // namespace jccu
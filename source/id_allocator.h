@@ -0,0 +1,37 @@
+#ifndef JCCU_SOURCE_ID_ALLOCATOR_H
+#define JCCU_SOURCE_ID_ALLOCATOR_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QMap>
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Hands out the smallest unused id (ids start at 1).
+/// Free ids below the highest used id are kept as ranges, so finding,
+/// reserving and releasing an id are all O(log n) in the number of gaps.
+///////////////////////////////////////////////////////////////////////////////
+class IdAllocator
+{
+  public:
+    IdAllocator();
+    ~IdAllocator();
+
+    bool reserve(int id);
+    bool release(int id);
+    void clear();
+
+    bool used(int id) const;
+    int next() const;
+
+  private:
+    QMap<int, int> free_ranges_; // <FirstFreeId, LastFreeId>
+    int top_;                    // Highest used id. Everything above is free.
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_ID_ALLOCATOR_H
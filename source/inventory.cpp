@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "inventory.h"
+
+#include "can_manager.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor. Copies the managers' current contents.
+///////////////////////////////////////////////////////////////////////////////
+Inventory::Inventory(const GoodManager* good_manager,
+                     const DateManager* date_manager,
+                     const CanManager* can_manager)
+  : goods_container_(good_manager->goods()),
+    dates_container_(date_manager->dates()),
+    cans_goods_container_(can_manager->goodIds()),
+    cans_dates_container_(can_manager->dateIds()),
+    cans_quantities_container_(can_manager->lotQuantities())
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+Inventory::~Inventory()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns all goods by id.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, QString>& Inventory::goods() const
+{
+  return goods_container_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns all dates by id.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, int64_t>& Inventory::dates() const
+{
+  return dates_container_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the good id of every can by can id.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, int>& Inventory::canGoodIds() const
+{
+  return cans_goods_container_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the date id of every can by can id.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, int>& Inventory::canDateIds() const
+{
+  return cans_dates_container_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the quantity of every lot by can id. Single cans aren't listed.
+///////////////////////////////////////////////////////////////////////////////
+const QHash<int, int>& Inventory::canQuantities() const
+{
+  return cans_quantities_container_;
+}
+
+} // namespace jccu
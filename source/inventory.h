@@ -0,0 +1,48 @@
+#ifndef JCCU_SOURCE_INVENTORY_H
+#define JCCU_SOURCE_INVENTORY_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <stdint.h>
+#include <QHash>
+#include <QString>
+
+namespace jccu
+{
+
+class GoodManager;
+class DateManager;
+class CanManager;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Read-only copy of everything the managers hold.
+/// The containers are implicitly shared with the managers, so taking one is
+/// cheap and it can be handed to another thread; the managers detach from
+/// it on their next change.
+///////////////////////////////////////////////////////////////////////////////
+class Inventory
+{
+  public:
+    Inventory(const GoodManager* good_manager,
+              const DateManager* date_manager,
+              const CanManager* can_manager);
+    ~Inventory();
+
+    const QHash<int, QString>& goods() const;
+    const QHash<int, int64_t>& dates() const;
+    const QHash<int, int>& canGoodIds() const;
+    const QHash<int, int>& canDateIds() const;
+    const QHash<int, int>& canQuantities() const;
+
+  private:
+    QHash<int, QString> goods_container_;       // <GoodId, Good>
+    QHash<int, int64_t> dates_container_;       // <DateId, Date>
+    QHash<int, int> cans_goods_container_;      // <CanId, GoodId>
+    QHash<int, int> cans_dates_container_;      // <CanId, DateId>
+    QHash<int, int> cans_quantities_container_; // <CanId, Quantity>, lots
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_INVENTORY_H
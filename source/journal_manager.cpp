@@ -0,0 +1,619 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "journal_manager.h"
+
+#include <string.h>
+#include <QtEndian>
+#include <QtGlobal>
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "can_manager.h"
+#include "metrics.h"
+#include "trace.h"
+
+namespace jccu
+{
+
+const char JournalManager::Magic[4] = {'J', 'C', 'C', 'J'};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Flushes file and has the OS write it through its cache to the disk.
+/// Returns true on success.
+///////////////////////////////////////////////////////////////////////////////
+static bool Sync(QFile* file)
+{
+  if(!file->flush())
+    return false;
+
+#ifdef Q_OS_WIN
+  HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(file->handle()));
+  return FlushFileBuffers(handle) != 0;
+#else
+  return fsync(file->handle()) == 0;
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+///////////////////////////////////////////////////////////////////////////////
+JournalManager::JournalManager(const QString& file_name,
+                               GoodManager* good_manager,
+                               DateManager* date_manager,
+                               CanManager* can_manager)
+  : file_name_(file_name),
+    goods_(good_manager),
+    dates_(date_manager),
+    cans_(can_manager),
+    generation_(0)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+JournalManager::~JournalManager()
+{
+  close();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Replays the journal on top of what the managers hold, which must be the
+/// snapshot with the given generation and journal offset. If that snapshot
+/// was followed by a rotation, the previous journal is replayed first.
+/// The journal must not be open. Outputs where the current journal's last
+/// good record ends to replayed_size, or zero if replay didn't get to it.
+/// Returns the number of records replayed.
+///////////////////////////////////////////////////////////////////////////////
+int JournalManager::replay(quint64 generation, qint64 offset,
+                           qint64* replayed_size)
+{
+  JCCU_TRACE("JournalManager::replay");
+
+  if(replayed_size)
+    *replayed_size = 0;
+
+  if(!valid() || file_.isOpen())
+    return 0;
+
+  int replayed = replayFile(file_name_, generation, false, offset,
+                            replayed_size);
+
+  if(replayed >= 0)
+    return replayed;
+
+  replayed = replayFile(file_name_ + ".old", generation, false, offset);
+
+  if(replayed < 0)
+    return 0;
+
+  return replayed + qMax(replayFile(file_name_, generation, true, 0,
+                                    replayed_size), 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Starts a new, empty journal with the given generation and begins
+/// recording the managers' changes to it. The previous generation is only
+/// set when rotating.
+/// Returns true on success.
+///////////////////////////////////////////////////////////////////////////////
+bool JournalManager::open(quint64 generation, quint64 previous_generation)
+{
+  JCCU_TRACE("JournalManager::open");
+
+  close();
+
+  if(!valid())
+    return false;
+
+  file_.setFileName(file_name_);
+
+  if(!file_.open(QFile::WriteOnly | QFile::Truncate))
+    return false;
+
+  QByteArray header(HeaderSize, Qt::Uninitialized);
+  uchar* pos = reinterpret_cast<uchar*>(header.data());
+
+  memcpy(pos, Magic, sizeof(Magic));
+  qToLittleEndian<quint32>(Version, pos + 4);
+  qToLittleEndian<quint64>(generation, pos + 8);
+  qToLittleEndian<quint64>(previous_generation, pos + 16);
+
+  if(file_.write(header) != HeaderSize || !Sync(&file_)) {
+    file_.close();
+    return false;
+  }
+
+  Metrics::Add(Metrics::BytesWritten, HeaderSize);
+  generation_ = generation;
+  attach(this);
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reopens the journal a replay finished in and carries on recording to it,
+/// dropping anything after replayed_size, where replay said its last good
+/// record ends. The replay may have been done by another manager over the
+/// same file, e.g. on a worker thread. This saves writing a new snapshot up
+/// front; the snapshot on disk plus the replayed journals still hold
+/// everything.
+/// Returns false if replay didn't finish in the current journal.
+///////////////////////////////////////////////////////////////////////////////
+bool JournalManager::resume(qint64 replayed_size)
+{
+  JCCU_TRACE("JournalManager::resume");
+
+  close();
+
+  if(!valid() || !replayed_size)
+    return false;
+
+  file_.setFileName(file_name_);
+
+  if(!file_.open(QFile::ReadWrite))
+    return false;
+
+  QByteArray header = file_.read(HeaderSize);
+
+  if(header.size() != HeaderSize || !file_.resize(replayed_size) ||
+     !file_.seek(replayed_size)) {
+    file_.close();
+    return false;
+  }
+
+  const uchar* pos = reinterpret_cast<const uchar*>(header.constData());
+
+  generation_ = qFromLittleEndian<quint64>(pos + 8);
+  attach(this);
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Keeps the current journal as the previous one and opens a new journal
+/// with the given generation in its place.
+/// Returns true on success.
+///////////////////////////////////////////////////////////////////////////////
+bool JournalManager::rotate(quint64 generation)
+{
+  JCCU_TRACE("JournalManager::rotate");
+
+  quint64 previous_generation = generation_;
+  QString old_file_name = file_name_ + ".old";
+
+  close();
+
+  if(QFile::exists(file_name_)) {
+    QFile::remove(old_file_name);
+
+    if(!QFile::rename(file_name_, old_file_name))
+      return false;
+  }
+
+  return open(generation, previous_generation);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Stops recording and closes the journal.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::close()
+{
+  if(!file_.isOpen())
+    return;
+
+  attach(nullptr);
+  file_.close();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the name of the journal file.
+///////////////////////////////////////////////////////////////////////////////
+const QString& JournalManager::fileName() const
+{
+  return file_name_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the generation of the open journal.
+///////////////////////////////////////////////////////////////////////////////
+quint64 JournalManager::generation() const
+{
+  return generation_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the size of the open journal in bytes.
+///////////////////////////////////////////////////////////////////////////////
+qint64 JournalManager::size() const
+{
+  return file_.isOpen() ? file_.size() : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that good good was inserted with id good_id.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::goodInserted(int good_id, const QString& good)
+{
+  append(GoodInserted, QList<int>() << good_id, good.toUtf8());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that the good with id good_id was removed.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::goodRemoved(int good_id)
+{
+  append(GoodRemoved, QList<int>() << good_id);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that date date was inserted with id date_id.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::dateInserted(int date_id, int64_t date)
+{
+  QByteArray extra(8, Qt::Uninitialized);
+  qToLittleEndian<qint64>(date, reinterpret_cast<uchar*>(extra.data()));
+
+  append(DateInserted, QList<int>() << date_id, extra);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that the date with id date_id was removed.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::dateRemoved(int date_id)
+{
+  append(DateRemoved, QList<int>() << date_id);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that the dates were removed together, as a single record.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::datesRemoved(const QList<int>& date_ids)
+{
+  append(DateRemoved, date_ids);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that the can was inserted. The quantity is only recorded for
+/// lots, so single cans keep their old record.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::canInserted(int can_id,
+                                 int good_id,
+                                 int date_id,
+                                 int quantity)
+{
+  QList<int> ids;
+  ids << can_id << good_id << date_id;
+
+  if(quantity > 1)
+    ids << quantity;
+
+  append(CanInserted, ids);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that the quantity of the can changed to quantity.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::canQuantityChanged(int can_id, int quantity)
+{
+  append(CanQuantityChanged, QList<int>() << can_id << quantity);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that the good of the given cans changed to good_id.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::cansGoodChanged(const QList<int>& can_ids, int good_id)
+{
+  append(CansGoodChanged, QList<int>() << good_id << can_ids);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that the date of the given cans changed to date_id.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::cansDateChanged(const QList<int>& can_ids, int date_id)
+{
+  append(CansDateChanged, QList<int>() << date_id << can_ids);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records that the given cans were removed.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::cansRemoved(const QList<int>& can_ids)
+{
+  append(CansRemoved, can_ids);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Points the managers at journal, or stops them recording if it's null.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::attach(JournalManager* journal)
+{
+  goods_->setJournal(journal);
+  dates_->setJournal(journal);
+  cans_->setJournal(journal);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Replays the journal file file_name from offset onwards, if its
+/// generation (or previous generation, if as_previous) is generation.
+/// Outputs where the last good record ends to replayed_size, if it's
+/// non-null and the file matches.
+/// Returns the number of records replayed, or -1 if the file doesn't match.
+///////////////////////////////////////////////////////////////////////////////
+int JournalManager::replayFile(const QString& file_name,
+                               quint64 generation,
+                               bool as_previous,
+                               qint64 offset,
+                               qint64* replayed_size)
+{
+  QFile file(file_name);
+
+  if(!file.open(QFile::ReadOnly))
+    return -1;
+
+  qint64 size = file.size();
+
+  if(size < HeaderSize)
+    return -1;
+
+  const uchar* data = file.map(0, size);
+
+  if(!data)
+    return -1;
+
+  const int generation_offset = as_previous ? 16 : 8;
+
+  if(memcmp(data, Magic, sizeof(Magic)) != 0 ||
+     qFromLittleEndian<quint32>(data + 4) != Version ||
+     qFromLittleEndian<quint64>(data + generation_offset) != generation) {
+    file.unmap(const_cast<uchar*>(data));
+    return -1;
+  }
+
+  const uchar* end = data + size;
+  const uchar* pos = data + qBound<qint64>(HeaderSize, offset, size);
+  int replayed = 0;
+
+  while(end - pos >= RecordHeaderSize) {
+    qint64 payload_size = qFromLittleEndian<quint32>(pos);
+    quint16 checksum = qFromLittleEndian<quint16>(pos + 4);
+    const uchar* payload = pos + RecordHeaderSize;
+
+    if(payload_size < 1 || payload_size > end - payload)
+      break;
+
+    if(qChecksum(reinterpret_cast<const char*>(payload),
+                 payload_size) != checksum)
+      break;
+
+    if(!apply(payload, payload_size))
+      break;
+
+    pos = payload + payload_size;
+    ++replayed;
+  }
+
+  if(replayed_size)
+    *replayed_size = pos - data;
+
+  file.unmap(const_cast<uchar*>(data));
+
+  return replayed;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Applies the size byte record payload to the managers.
+/// Changes that no longer apply are skipped, since the managers make the
+/// same follow-up changes (e.g. removing orphaned dates) while replaying.
+/// Returns false if the payload is malformed.
+///////////////////////////////////////////////////////////////////////////////
+bool JournalManager::apply(const uchar* payload, int size)
+{
+  const int type = payload[0];
+  const uchar* fields = payload + 1;
+  const int fields_size = size - 1;
+
+  QList<int> ids;
+
+  switch(type) {
+    case GoodInserted:
+    case DateInserted:
+      if(fields_size < 4)
+        return false;
+
+      ids.append(qFromLittleEndian<qint32>(fields));
+      break;
+
+    case GoodRemoved:
+    case DateRemoved:
+    case CanInserted:
+    case CansGoodChanged:
+    case CansDateChanged:
+    case CansRemoved:
+    case CanQuantityChanged:
+      if(fields_size % 4)
+        return false;
+
+      for(int i = 0; i < fields_size; i += 4)
+        ids.append(qFromLittleEndian<qint32>(fields + i));
+
+      break;
+
+    default:
+      return false;
+  }
+
+  switch(type) {
+    case GoodInserted: {
+      QString good = QString::fromUtf8(
+        reinterpret_cast<const char*>(fields + 4), fields_size - 4);
+
+      goods_->insert(ids.at(0), good);
+      return true;
+    }
+
+    case GoodRemoved:
+      if(ids.size() != 1)
+        return false;
+
+      if(goods_->exists(ids.at(0)))
+        goods_->remove(goods_->good(ids.at(0)));
+
+      return true;
+
+    case DateInserted:
+      if(fields_size != 4 + 8)
+        return false;
+
+      dates_->insert(ids.at(0), qFromLittleEndian<qint64>(fields + 4));
+      return true;
+
+    case DateRemoved:
+      if(ids.isEmpty())
+        return false;
+
+      dates_->removeMany(ids);
+      return true;
+
+    case CanInserted:
+      if(ids.size() != 3 && ids.size() != 4)
+        return false;
+
+      cans_->insert(ids.at(0), ids.at(1), ids.at(2), ids.value(3, 1));
+      return true;
+
+    case CansGoodChanged: {
+      if(ids.isEmpty())
+        return false;
+
+      int good_id = ids.takeFirst();
+
+      // A single can is moved into place rather than re-sorting them all.
+      if(!goods_->exists(good_id))
+        return true;
+
+      if(ids.size() == 1)
+        cans_->editGood(ids.at(0), goods_->good(good_id));
+      else
+        cans_->editGoods(ids, goods_->good(good_id));
+
+      return true;
+    }
+
+    case CansDateChanged: {
+      if(ids.isEmpty())
+        return false;
+
+      int date_id = ids.takeFirst();
+
+      if(!dates_->exists(date_id))
+        return true;
+
+      if(ids.size() == 1)
+        cans_->editDate(ids.at(0), dates_->date(date_id));
+      else
+        cans_->editDates(ids, dates_->date(date_id));
+
+      return true;
+    }
+
+    case CansRemoved:
+      cans_->removeMany(ids);
+      return true;
+
+    case CanQuantityChanged:
+      if(ids.size() != 2)
+        return false;
+
+      cans_->setQuantity(ids.at(0), ids.at(1));
+      return true;
+  }
+
+  return false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Appends a record of the given type, made of ids and then extra, and
+/// syncs it to the disk before returning, so a record survives a crash or
+/// a power cut as soon as the change is made. Changes come one user action
+/// at a time, and bulk edits are a single record, so the sync per record
+/// is affordable.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManager::append(RecordType type,
+                            const QList<int>& ids,
+                            const QByteArray& extra)
+{
+  if(!file_.isOpen())
+    return;
+
+  const int payload_size = 1 + ids.size() * 4 + extra.size();
+  QByteArray record(RecordHeaderSize + payload_size, Qt::Uninitialized);
+  uchar* header = reinterpret_cast<uchar*>(record.data());
+  uchar* payload = header + RecordHeaderSize;
+  uchar* pos = payload;
+
+  *pos++ = type;
+
+  auto it = ids.constBegin(),
+       end = ids.constEnd();
+
+  for(; it != end; ++it, pos += 4)
+    qToLittleEndian<qint32>(*it, pos);
+
+  memcpy(pos, extra.constData(), extra.size());
+
+  quint16 checksum = qChecksum(reinterpret_cast<const char*>(payload),
+                               payload_size);
+
+  qToLittleEndian<quint32>(payload_size, header);
+  qToLittleEndian<quint16>(checksum, header + 4);
+
+  file_.write(record);
+  Sync(&file_);
+
+  Metrics::Add(Metrics::BytesWritten, record.size());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if the manager is in a valid state.
+///////////////////////////////////////////////////////////////////////////////
+bool JournalManager::valid() const
+{
+  if(file_name_.isEmpty())
+    return false;
+
+  if(!goods_ || !dates_ || !cans_)
+    return false;
+
+  return true;
+}
+
+} // namespace jccu
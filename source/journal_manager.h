@@ -0,0 +1,114 @@
+#ifndef JCCU_SOURCE_JOURNAL_MANAGER_H
+#define JCCU_SOURCE_JOURNAL_MANAGER_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <stdint.h>
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+namespace jccu
+{
+
+class GoodManager;
+class DateManager;
+class CanManager;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Manages the mutation journal.
+/// While open, every change the managers make is appended to the journal as
+/// a small record, so saving costs as much as the change rather than the
+/// whole inventory. A journal is replayed on top of the snapshot with the
+/// same generation, from the offset the snapshot names.
+///
+/// Rotating keeps the previous journal until the next rotation, and the new
+/// journal names it as its predecessor. A snapshot that's still being
+/// written when the journal rotates therefore isn't needed: the old
+/// snapshot, the previous journal and the new journal together hold
+/// everything. All fields are little endian:
+///
+///   header   "JCCJ", version (2 x 4 bytes), generation, previous
+///            generation (2 x 8 bytes)
+///   records  payload size (4 bytes), payload checksum (2 bytes), payload
+///
+/// A payload is a record type byte followed by the record's ids. Replay
+/// stops at the first damaged record, which is usually a torn write; a
+/// replayed journal can be resumed from there instead of starting afresh.
+///////////////////////////////////////////////////////////////////////////////
+class JournalManager
+{
+  public:
+    JournalManager(const QString& file_name,
+                   GoodManager* good_manager,
+                   DateManager* date_manager,
+                   CanManager* can_manager);
+    ~JournalManager();
+
+    int replay(quint64 generation, qint64 offset,
+               qint64* replayed_size = nullptr);
+    bool open(quint64 generation, quint64 previous_generation = 0);
+    bool resume(qint64 replayed_size);
+    bool rotate(quint64 generation);
+    void close();
+
+    const QString& fileName() const;
+    quint64 generation() const;
+    qint64 size() const;
+
+    void goodInserted(int good_id, const QString& good);
+    void goodRemoved(int good_id);
+    void dateInserted(int date_id, int64_t date);
+    void dateRemoved(int date_id);
+    void datesRemoved(const QList<int>& date_ids);
+    void canInserted(int can_id, int good_id, int date_id, int quantity);
+    void canQuantityChanged(int can_id, int quantity);
+    void cansGoodChanged(const QList<int>& can_ids, int good_id);
+    void cansDateChanged(const QList<int>& can_ids, int date_id);
+    void cansRemoved(const QList<int>& can_ids);
+
+  private:
+    enum RecordType {
+      GoodInserted = 1,
+      GoodRemoved,
+      DateInserted,
+      DateRemoved,
+      CanInserted,
+      CansGoodChanged,
+      CansDateChanged,
+      CansRemoved,
+      CanQuantityChanged
+    };
+
+    JournalManager(const JournalManager&);
+    JournalManager& operator=(const JournalManager&);
+
+    void attach(JournalManager* journal);
+    int replayFile(const QString& file_name,
+                   quint64 generation,
+                   bool as_previous,
+                   qint64 offset,
+                   qint64* replayed_size = nullptr);
+    bool apply(const uchar* payload, int size);
+    void append(RecordType type, const QList<int>& ids,
+                const QByteArray& extra = QByteArray());
+    bool valid() const;
+
+    static const char Magic[4];
+    static const quint32 Version = 2;
+    static const int HeaderSize = 2 * 4 + 2 * 8;
+    static const int RecordHeaderSize = 4 + 2;
+
+    QString file_name_;
+    GoodManager* goods_;
+    DateManager* dates_;
+    CanManager* cans_;
+    QFile file_;
+    quint64 generation_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_JOURNAL_MANAGER_H
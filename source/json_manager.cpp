@@ -5,11 +5,13 @@
 
 #include <QByteArray>
 #include <QFile>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QSaveFile>
 #include "can_manager.h"
+#include "inventory.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "trace.h"
 
 namespace jccu
 {
@@ -39,9 +41,16 @@ JsonManager::~JsonManager()
 
 ///////////////////////////////////////////////////////////////////////////////
 /// Reads in data from json.
+/// The file is tokenized as it's read, so goods, dates and cans are inserted
+/// without ever holding the whole document in memory. v1 files (no
+/// version), v2 files and v3 files are read; newer files are refused.
+/// Outputs the file's journal generation and offset to generation and
+/// journal_offset, if they're non-null; both are zero if it has none.
 ///////////////////////////////////////////////////////////////////////////////
-bool JsonManager::read()
+bool JsonManager::read(quint64* generation, qint64* journal_offset)
 {
+  JCCU_TRACE("JsonManager::read");
+
   if(!valid())
     return false;
 
@@ -54,127 +63,387 @@ bool JsonManager::read()
   if(!file.open(QFile::ReadOnly))
     return false;
 
-  QByteArray json_data = file.readAll();
-  auto json_document = QJsonDocument::fromJson(json_data);
+  JsonReader reader(&file);
 
-  if(json_document.isNull())
+  if(reader.next() != JsonReader::BeginObject)
     return false;
 
-  if(json_document.isArray())
+  // Cans can come before the goods and dates they reference (the v1 writer
+  // sorted keys); the bulk load only checks references once it ends.
+  goods_->beginBulkLoad();
+  dates_->beginBulkLoad();
+  cans_->beginBulkLoad();
+
+  bool ok = true;
+  int64_t file_generation = 0;
+  int64_t file_journal_offset = 0;
+
+  auto ReadNumber = [&reader](int64_t* number) -> bool {
+    if(reader.next() != JsonReader::Number)
+      return false;
+
+    *number = reader.toInt64();
+    return true;
+  };
+
+  while(ok && reader.next() == JsonReader::Name) {
+    QByteArray section = reader.text();
+
+    if(section == "version")
+      ok = reader.next() == JsonReader::Number &&
+           reader.toInt() <= Version;
+    else if(section == "generation")
+      ok = ReadNumber(&file_generation);
+    else if(section == "journal_offset")
+      ok = ReadNumber(&file_journal_offset);
+    else if(section == "goods")
+      ok = readGoods(&reader);
+    else if(section == "dates")
+      ok = readDates(&reader);
+    else if(section == "cans")
+      ok = readCans(&reader);
+    else
+      ok = reader.skipValue();
+  }
+
+  if(!ok || reader.token() != JsonReader::EndObject ||
+     reader.next() != JsonReader::EndDocument)
+    ok = false;
+
+  goods_->endBulkLoad();
+  dates_->endBulkLoad();
+  cans_->endBulkLoad();
+
+  if(!ok) {
+    cans_->clear();
+    dates_->clear();
+    goods_->clear();
+  }
+
+  if(ok && generation)
+    *generation = file_generation;
+
+  if(ok && journal_offset)
+    *journal_offset = file_journal_offset;
+
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes data out to json.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonManager::write() const
+{
+  if(!valid())
     return false;
 
-  goods_->clear();
-  dates_->clear();
-  cans_->clear();
+  return Write(file_name_, Inventory(goods_, dates_, cans_));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the name of the json file.
+///////////////////////////////////////////////////////////////////////////////
+const QString& JsonManager::fileName() const
+{
+  return file_name_;
+}
 
-  auto json_object = json_document.object();
 
-  auto goods_object = json_object.value("goods").toObject();
-  auto goods_it = goods_object.constBegin(),
-       goods_end = goods_object.constEnd();
+///////////////////////////////////////////////////////////////////////////////
+/// Writes inventory out to the json file file_name, as compact v3:
+/// {"version": 3, "generation": generation, "journal_offset": offset,
+///  "goods": [[good id, "good"], ...],
+///  "dates": [[date id, julian day], ...],
+///  "cans": [[can id, good id, date id], ...]}
+/// Lots have their quantity as a fourth field; v2 is the same, minus lots.
+/// The journal position comes straight after the version, so it can be read
+/// without reading the rest, and is left out if generation is zero.
+/// Only reads inventory, so it's safe to call from any thread.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonManager::Write(const QString& file_name,
+                        const Inventory& inventory,
+                        quint64 generation,
+                        qint64 journal_offset)
+{
+  JCCU_TRACE("JsonManager::Write");
 
-  for(; goods_it != goods_end; ++goods_it) {
-    int good_id = goods_it.key().toInt();
-    QString good = goods_it.value().toString();
+  JsonWriter writer(JsonWriter::Compact);
+  writer.beginObject();
 
-    goods_->insert(good_id, good);
+  writer.name("version");
+  writer.value(Version);
+
+  if(generation) {
+    writer.name("generation");
+    writer.value(static_cast<qint64>(generation));
+    writer.name("journal_offset");
+    writer.value(journal_offset);
   }
 
-  auto dates_object = json_object.value("dates").toObject();
-  auto dates_it = dates_object.constBegin(),
-       dates_end = dates_object.constEnd();
+  writer.name("goods");
+  writer.beginArray();
 
-  // Can't convert from QJsonValue -> long long.
-  // Use QString as an intermediary.
-  for(; dates_it != dates_end; ++dates_it) {
-    int date_id = dates_it.key().toInt();
-    int64_t date = dates_it.value().toString().toLongLong();
+  auto good_it = inventory.goods().constBegin(),
+       good_end = inventory.goods().constEnd();
 
-    dates_->insert(date_id, date);
+  for(; good_it != good_end; ++good_it) {
+    writer.beginArray();
+    writer.value(good_it.key());
+    writer.value(good_it.value());
+    writer.endArray();
   }
 
-  auto cans_object = json_object.value("cans").toObject();
-  auto cans_it = cans_object.constBegin(),
-       cans_end = cans_object.constEnd();
+  writer.endArray();
+
+  writer.name("dates");
+  writer.beginArray();
+
+  auto date_it = inventory.dates().constBegin(),
+       date_end = inventory.dates().constEnd();
+
+  for(; date_it != date_end; ++date_it) {
+    writer.beginArray();
+    writer.value(date_it.key());
+    writer.value(static_cast<qint64>(date_it.value()));
+    writer.endArray();
+  }
+
+  writer.endArray();
+
+  writer.name("cans");
+  writer.beginArray();
 
-  for(; cans_it != cans_end; ++cans_it) {
-    auto can_array = cans_it.value().toArray();
-    int can_id = cans_it.key().toInt();
-    int good_id = can_array[0].toString().toInt();
-    int date_id = can_array[1].toString().toInt();
+  auto can_it = inventory.canGoodIds().constBegin(),
+       can_end = inventory.canGoodIds().constEnd();
 
-    cans_->insert(can_id, good_id, date_id);
+  for(; can_it != can_end; ++can_it) {
+    int quantity = inventory.canQuantities().value(can_it.key(), 1);
+
+    writer.beginArray();
+    writer.value(can_it.key());
+    writer.value(can_it.value());
+    writer.value(inventory.canDateIds().value(can_it.key()));
+
+    if(quantity > 1)
+      writer.value(quantity);
+
+    writer.endArray();
   }
 
+  writer.endArray();
+  writer.endObject();
+
+  QSaveFile file(file_name);
+  
+  if(!file.open(QSaveFile::WriteOnly))
+    return false;
+
+  file.write(writer.data());
+
+  if(!file.commit())
+    return false;
+
+  Metrics::Add(Metrics::BytesWritten, writer.data().size());
   return true;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-/// Writes data out to json.
+/// Reads only the journal generation and offset the json file file_name
+/// continues into, which come before any goods, dates or cans.
+/// Returns false if the file can't be read or doesn't name a generation.
 ///////////////////////////////////////////////////////////////////////////////
-bool JsonManager::write() const
+bool JsonManager::ReadJournalPosition(const QString& file_name,
+                                      quint64* generation,
+                                      qint64* journal_offset)
 {
-  if(!valid())
+  QFile file(file_name);
+
+  if(!file.open(QFile::ReadOnly))
+    return false;
+
+  JsonReader reader(&file);
+
+  if(reader.next() != JsonReader::BeginObject)
     return false;
 
-  QJsonObject goods_object;
+  *generation = 0;
+  *journal_offset = 0;
 
-  int rows = goods_->rowCount();
+  while(reader.next() == JsonReader::Name) {
+    QByteArray section = reader.text();
 
-  for(int i = 0; i < rows; ++i) {
-    QString good_id = goods_->data(goods_->index(i, 0)).toString();
-    QString good = goods_->data(goods_->index(i, 1)).toString();
-    goods_object[good_id] = good;
+    if(section != "version" && section != "generation" &&
+       section != "journal_offset")
+      break;
+
+    if(reader.next() != JsonReader::Number)
+      return false;
+
+    if(section == "generation")
+      *generation = reader.toInt64();
+    else if(section == "journal_offset")
+      *journal_offset = reader.toInt64();
   }
 
-  QJsonObject json_object;
-  json_object["goods"] = goods_object;
+  return *generation != 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads the goods, either as a v1 object: {"good id": "good", ...}
+/// or as a v2 array: [[good id, "good"], ...].
+///////////////////////////////////////////////////////////////////////////////
+bool JsonManager::readGoods(JsonReader* reader)
+{
+  auto token = reader->next();
+
+  if(token == JsonReader::BeginObject) {
+    while(reader->next() == JsonReader::Name) {
+      int good_id = reader->toInt();
 
-  QJsonObject dates_object;
+      if(reader->next() != JsonReader::String)
+        return false;
 
-  rows = dates_->rowCount();
+      goods_->insert(good_id, reader->string());
+    }
 
-  for(int i = 0; i < rows; ++i) {
-    QString date_id = dates_->data(dates_->index(i, 0)).toString();
-    QString date = dates_->data(dates_->index(i, 1)).toString();
-    dates_object[date_id] = date;
+    return reader->token() == JsonReader::EndObject;
   }
 
-  json_object["dates"] = dates_object;
+  if(token != JsonReader::BeginArray)
+    return false;
 
-  QJsonObject cans_object;
+  while(reader->next() == JsonReader::BeginArray) {
+    if(reader->next() != JsonReader::Number)
+      return false;
 
-  rows = cans_->rowCount();
+    int good_id = reader->toInt();
 
-  for(int i = 0; i < rows; ++i) {
-    QString can_id = cans_->data(cans_->index(i, 0)).toString();
-    QString good_id = cans_->data(cans_->index(i, 1),
-                                  CanManager::IdRole).toString();
-    QString date_id = cans_->data(cans_->index(i, 2),
-                                  CanManager::IdRole).toString();
+    if(reader->next() != JsonReader::String)
+      return false;
 
-    QJsonArray can_array;
-    can_array.append(good_id);
-    can_array.append(date_id);
+    goods_->insert(good_id, reader->string());
 
-    cans_object[can_id] = can_array;
+    if(reader->next() != JsonReader::EndArray)
+      return false;
   }
 
-  json_object["cans"] = cans_object;
+  return reader->token() == JsonReader::EndArray;
+}
 
-  QSaveFile file(file_name_);
-  QJsonDocument json_document(json_object);
-  
-  if(!file.open(QSaveFile::WriteOnly))
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads the dates, either as a v1 object: {"date id": "julian day", ...}
+/// or as a v2 array: [[date id, julian day], ...].
+///////////////////////////////////////////////////////////////////////////////
+bool JsonManager::readDates(JsonReader* reader)
+{
+  auto token = reader->next();
+  int64_t fields[2];
+
+  if(token == JsonReader::BeginObject) {
+    while(reader->next() == JsonReader::Name) {
+      int date_id = reader->toInt();
+      token = reader->next();
+
+      if(token != JsonReader::String && token != JsonReader::Number)
+        return false;
+
+      dates_->insert(date_id, reader->toInt64());
+    }
+
+    return reader->token() == JsonReader::EndObject;
+  }
+
+  if(token != JsonReader::BeginArray)
     return false;
 
-  file.write(json_document.toJson());
+  while(reader->next() == JsonReader::BeginArray) {
+    if(!readNumbers(reader, fields, 2))
+      return false;
 
-  if(!file.commit())
+    dates_->insert(static_cast<int>(fields[0]), fields[1]);
+  }
+
+  return reader->token() == JsonReader::EndArray;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads the cans, either as a v1 object:
+/// {"can id": ["good id", "date id"], ...}
+/// or as a v2 or v3 array: [[can id, good id, date id], ...], where v3 lots
+/// add their quantity: [can id, good id, date id, quantity].
+///////////////////////////////////////////////////////////////////////////////
+bool JsonManager::readCans(JsonReader* reader)
+{
+  auto token = reader->next();
+  int64_t fields[4];
+
+  if(token == JsonReader::BeginObject) {
+    while(reader->next() == JsonReader::Name) {
+      int can_id = reader->toInt();
+
+      if(reader->next() != JsonReader::BeginArray)
+        return false;
+
+      if(!readNumbers(reader, fields, 2))
+        return false;
+
+      cans_->insert(can_id,
+                    static_cast<int>(fields[0]),
+                    static_cast<int>(fields[1]));
+    }
+
+    return reader->token() == JsonReader::EndObject;
+  }
+
+  if(token != JsonReader::BeginArray)
     return false;
 
-  return true;
+  while(reader->next() == JsonReader::BeginArray) {
+    fields[3] = 1;
+
+    if(!readNumbers(reader, fields, 3, 1))
+      return false;
+
+    cans_->insert(static_cast<int>(fields[0]),
+                  static_cast<int>(fields[1]),
+                  static_cast<int>(fields[2]),
+                  static_cast<int>(fields[3]));
+  }
+
+  return reader->token() == JsonReader::EndArray;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads the rest of an array that holds count numbers, and then up to
+/// optional_count more, into fields. Fields for missing optional numbers
+/// are left as they were.
+/// v1 numbers are strings, so those are accepted too.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonManager::readNumbers(JsonReader* reader,
+                              int64_t* fields,
+                              int count,
+                              int optional_count)
+{
+  for(int i = 0; i < count + optional_count; ++i) {
+    auto token = reader->next();
+
+    if(i >= count && token == JsonReader::EndArray)
+      return true;
+
+    if(token != JsonReader::String && token != JsonReader::Number)
+      return false;
+
+    fields[i] = reader->toInt64();
+  }
+
+  return reader->next() == JsonReader::EndArray;
 }
 
 
@@ -4,7 +4,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 /// Includes
 ///////////////////////////////////////////////////////////////////////////////
+#include <stdint.h>
 #include <QString>
+#include <QtGlobal>
 
 namespace jccu
 {
@@ -12,9 +14,14 @@ namespace jccu
 class GoodManager;
 class DateManager;
 class CanManager;
+class Inventory;
+class JsonReader;
 
 ///////////////////////////////////////////////////////////////////////////////
 /// Manages json file reading and writing.
+/// Files we write name the journal generation and offset their contents
+/// continue into, like a snapshot does. A file without them was written by
+/// hand (or by an older version), and the journal doesn't apply to it.
 ///////////////////////////////////////////////////////////////////////////////
 class JsonManager
 {
@@ -25,19 +32,38 @@ class JsonManager
                 CanManager* can_manager);
     ~JsonManager();
 
-    bool read();
+    bool read(quint64* generation = nullptr, qint64* journal_offset = nullptr);
     bool write() const;
 
+    const QString& fileName() const;
+
+    static bool Write(const QString& file_name,
+                      const Inventory& inventory,
+                      quint64 generation = 0,
+                      qint64 journal_offset = 0);
+    static bool ReadJournalPosition(const QString& file_name,
+                                    quint64* generation,
+                                    qint64* journal_offset);
+
   private:
     JsonManager(const JsonManager&);
     JsonManager& operator=(const JsonManager&);
 
+    bool readGoods(JsonReader* reader);
+    bool readDates(JsonReader* reader);
+    bool readCans(JsonReader* reader);
+    bool readNumbers(JsonReader* reader,
+                     int64_t* fields,
+                     int count,
+                     int optional_count = 0);
     bool valid() const;
 
     QString file_name_;
     GoodManager* goods_;
     DateManager* dates_;
     CanManager* cans_;
+
+    static const int Version = 3;
 };
 
 } // namespace jccu
@@ -0,0 +1,484 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "json_reader.h"
+
+#include <QIODevice>
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+///////////////////////////////////////////////////////////////////////////////
+JsonReader::JsonReader(QIODevice* device)
+  : device_(device),
+    position_(0),
+    token_(Invalid),
+    expect_name_(false),
+    expect_separator_(false)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+JsonReader::~JsonReader()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads the next token and returns it.
+/// Returns Invalid on malformed input; every later call also returns Invalid.
+///////////////////////////////////////////////////////////////////////////////
+JsonReader::Token JsonReader::next()
+{
+  if(token_ == EndDocument || (token_ == Invalid && position_ < 0))
+    return token_;
+
+  text_.clear();
+
+  char c;
+
+  if(!skipWhitespace(&c)) {
+    if(containers_.isEmpty() && expect_separator_)
+      return token_ = EndDocument;
+
+    return fail();
+  }
+
+  // Close the current container.
+  if(c == '}' || c == ']') {
+    char open = (c == '}') ? '{' : '[';
+
+    if(containers_.isEmpty() || containers_.last() != open)
+      return fail();
+
+    // "[1,]" and "{"a":1,}" aren't allowed.
+    if(!expect_separator_ && token_ != BeginObject && token_ != BeginArray)
+      return fail();
+
+    containers_.removeLast();
+    expect_name_ = false;
+    expect_separator_ = true;
+    return token_ = (c == '}') ? EndObject : EndArray;
+  }
+
+  // Only one value at the top level.
+  if(containers_.isEmpty() && expect_separator_)
+    return fail();
+
+  if(expect_separator_) {
+    if(c != ',')
+      return fail();
+
+    if(!skipWhitespace(&c))
+      return fail();
+
+    expect_separator_ = false;
+    expect_name_ = (containers_.last() == '{');
+  }
+
+  if(expect_name_) {
+    if(c != '"' || !readString())
+      return fail();
+
+    char colon;
+
+    if(!skipWhitespace(&colon) || colon != ':')
+      return fail();
+
+    expect_name_ = false;
+    return token_ = Name;
+  }
+
+  return readValue(c);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Skips the value that was just read.
+/// If the current token opened an object or array, everything up to and
+/// including its end is skipped; otherwise the next value is skipped.
+/// Returns false on malformed input.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::skipValue()
+{
+  if(token_ == Name)
+    next();
+
+  int depth = 0;
+
+  if(token_ == BeginObject || token_ == BeginArray)
+    depth = 1;
+
+  while(depth > 0) {
+    switch(next()) {
+      case BeginObject:
+      case BeginArray:
+        ++depth;
+        break;
+
+      case EndObject:
+      case EndArray:
+        --depth;
+        break;
+
+      case Invalid:
+      case EndDocument:
+        return false;
+
+      default:
+        break;
+    }
+  }
+
+  return !hasError();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the current token.
+///////////////////////////////////////////////////////////////////////////////
+JsonReader::Token JsonReader::token() const
+{
+  return token_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if the input was malformed.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::hasError() const
+{
+  return token_ == Invalid && position_ < 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the UTF-8 text of the current name, string, number or literal.
+/// Escapes in names and strings have already been decoded.
+///////////////////////////////////////////////////////////////////////////////
+const QByteArray& JsonReader::text() const
+{
+  return text_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the text of the current token as a string.
+///////////////////////////////////////////////////////////////////////////////
+QString JsonReader::string() const
+{
+  return QString::fromUtf8(text_);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if the current token is the literal true.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::toBool() const
+{
+  return token_ == Bool && text_ == "true";
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Converts the current token's text to an int.
+/// Works for numbers as well as numeric strings and names.
+///////////////////////////////////////////////////////////////////////////////
+int JsonReader::toInt(bool* ok) const
+{
+  return text_.toInt(ok);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Converts the current token's text to a 64 bit int.
+/// Works for numbers as well as numeric strings and names.
+///////////////////////////////////////////////////////////////////////////////
+int64_t JsonReader::toInt64(bool* ok) const
+{
+  return text_.toLongLong(ok);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads the next byte, refilling the buffer from the device as needed.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::get(char* c)
+{
+  if(!peek(c))
+    return false;
+
+  ++position_;
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the next byte without consuming it.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::peek(char* c)
+{
+  const int ChunkSize = 64 * 1024;
+
+  if(position_ < 0)
+    return false;
+
+  if(position_ >= buffer_.size()) {
+    buffer_.resize(ChunkSize);
+    qint64 size = device_->read(buffer_.data(), ChunkSize);
+
+    if(size <= 0) {
+      buffer_.clear();
+      position_ = 0;
+      return false;
+    }
+
+    buffer_.resize(static_cast<int>(size));
+    position_ = 0;
+  }
+
+  *c = buffer_.at(position_);
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Skips whitespace and outputs the first byte after it.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::skipWhitespace(char* c)
+{
+  while(get(c))
+    if(*c != ' ' && *c != '\t' && *c != '\n' && *c != '\r')
+      return true;
+
+  return false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Puts the reader into the error state.
+///////////////////////////////////////////////////////////////////////////////
+JsonReader::Token JsonReader::fail()
+{
+  position_ = -1;
+  text_.clear();
+  return token_ = Invalid;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads a value starting with c.
+///////////////////////////////////////////////////////////////////////////////
+JsonReader::Token JsonReader::readValue(char c)
+{
+  switch(c) {
+    case '{':
+      containers_.append('{');
+      expect_name_ = true;
+      return token_ = BeginObject;
+
+    case '[':
+      containers_.append('[');
+      return token_ = BeginArray;
+
+    case '"':
+      if(!readString())
+        return fail();
+
+      token_ = String;
+      break;
+
+    case 't':
+    case 'f':
+    case 'n':
+      if(!readLiteral(c))
+        return fail();
+
+      token_ = (c == 'n') ? Null : Bool;
+      break;
+
+    default:
+      if(!readNumber(c))
+        return fail();
+
+      token_ = Number;
+      break;
+  }
+
+  expect_separator_ = true;
+  return token_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads the rest of a string whose opening quote was consumed.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::readString()
+{
+  char c;
+
+  while(get(&c)) {
+    if(c == '"')
+      return true;
+
+    if(c == '\\') {
+      if(!readEscape())
+        return false;
+    }
+    else if(static_cast<unsigned char>(c) < 0x20) {
+      return false;
+    }
+    else {
+      text_.append(c);
+    }
+  }
+
+  return false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads a number whose first byte is c.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::readNumber(char c)
+{
+  if(c != '-' && (c < '0' || c > '9'))
+    return false;
+
+  text_.append(c);
+
+  while(peek(&c)) {
+    bool digit = (c >= '0' && c <= '9');
+
+    if(!digit && c != '.' && c != 'e' && c != 'E' && c != '+' && c != '-')
+      break;
+
+    text_.append(c);
+    ++position_;
+  }
+
+  return text_ != "-";
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads true, false or null, whose first byte is c.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::readLiteral(char c)
+{
+  const char* literal = (c == 't') ? "true" : (c == 'f') ? "false" : "null";
+
+  text_.append(c);
+
+  for(const char* it = literal + 1; *it; ++it) {
+    if(!get(&c) || c != *it)
+      return false;
+
+    text_.append(c);
+  }
+
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads an escape sequence whose backslash was consumed.
+///////////////////////////////////////////////////////////////////////////////
+bool JsonReader::readEscape()
+{
+  char c;
+
+  if(!get(&c))
+    return false;
+
+  switch(c) {
+    case '"':  text_.append('"');  return true;
+    case '\\': text_.append('\\'); return true;
+    case '/':  text_.append('/');  return true;
+    case 'b':  text_.append('\b'); return true;
+    case 'f':  text_.append('\f'); return true;
+    case 'n':  text_.append('\n'); return true;
+    case 'r':  text_.append('\r'); return true;
+    case 't':  text_.append('\t'); return true;
+    case 'u':  break;
+    default:   return false;
+  }
+
+  // \uXXXX, possibly a surrogate pair.
+  uint code_point = 0;
+
+  for(int pair = 0; pair < 2; ++pair) {
+    uint unit = 0;
+
+    for(int i = 0; i < 4; ++i) {
+      if(!get(&c))
+        return false;
+
+      unit <<= 4;
+
+      if(c >= '0' && c <= '9')
+        unit |= c - '0';
+      else if(c >= 'a' && c <= 'f')
+        unit |= c - 'a' + 10;
+      else if(c >= 'A' && c <= 'F')
+        unit |= c - 'A' + 10;
+      else
+        return false;
+    }
+
+    if(pair == 0) {
+      code_point = unit;
+
+      // Not a high surrogate; done.
+      if(unit < 0xD800 || unit > 0xDBFF)
+        break;
+
+      char backslash, u;
+
+      if(!get(&backslash) || !get(&u) || backslash != '\\' || u != 'u')
+        return false;
+    }
+    else {
+      if(unit < 0xDC00 || unit > 0xDFFF)
+        return false;
+
+      code_point = 0x10000 + ((code_point - 0xD800) << 10) + (unit - 0xDC00);
+    }
+  }
+
+  appendUtf8(code_point);
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Appends the code point to the current text as UTF-8.
+///////////////////////////////////////////////////////////////////////////////
+void JsonReader::appendUtf8(uint code_point)
+{
+  if(code_point < 0x80) {
+    text_.append(static_cast<char>(code_point));
+  }
+  else if(code_point < 0x800) {
+    text_.append(static_cast<char>(0xC0 | (code_point >> 6)));
+    text_.append(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+  else if(code_point < 0x10000) {
+    text_.append(static_cast<char>(0xE0 | (code_point >> 12)));
+    text_.append(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    text_.append(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+  else {
+    text_.append(static_cast<char>(0xF0 | (code_point >> 18)));
+    text_.append(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    text_.append(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    text_.append(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+} // namespace jccu
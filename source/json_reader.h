@@ -0,0 +1,82 @@
+#ifndef JCCU_SOURCE_JSON_READER_H
+#define JCCU_SOURCE_JSON_READER_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <stdint.h>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Pull tokenizer for json.
+/// Reads the device in fixed-size chunks, so memory use doesn't depend on
+/// the size of the document. Only the current token's text is kept.
+///////////////////////////////////////////////////////////////////////////////
+class JsonReader
+{
+  public:
+    enum Token {
+      Invalid,
+      BeginObject,
+      EndObject,
+      BeginArray,
+      EndArray,
+      Name,
+      String,
+      Number,
+      Bool,
+      Null,
+      EndDocument
+    };
+
+    explicit JsonReader(QIODevice* device);
+    ~JsonReader();
+
+    Token next();
+    bool skipValue();
+
+    Token token() const;
+    bool hasError() const;
+
+    const QByteArray& text() const;
+    QString string() const;
+    bool toBool() const;
+    int toInt(bool* ok = nullptr) const;
+    int64_t toInt64(bool* ok = nullptr) const;
+
+  private:
+    JsonReader(const JsonReader&);
+    JsonReader& operator=(const JsonReader&);
+
+    bool get(char* c);
+    bool peek(char* c);
+    bool skipWhitespace(char* c);
+
+    Token fail();
+    Token readValue(char c);
+    bool readString();
+    bool readNumber(char c);
+    bool readLiteral(char c);
+    bool readEscape();
+    void appendUtf8(uint code_point);
+
+    QIODevice* device_;
+    QByteArray buffer_;
+    int position_;
+    QByteArray text_;
+    QVector<char> containers_; // '{' or '['
+    Token token_;
+    bool expect_name_;
+    bool expect_separator_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_JSON_READER_H
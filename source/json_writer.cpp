@@ -0,0 +1,224 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "json_writer.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+///////////////////////////////////////////////////////////////////////////////
+JsonWriter::JsonWriter(Format format)
+  : format_(format),
+    after_name_(false)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+JsonWriter::~JsonWriter()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Opens an object.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::beginObject()
+{
+  beginValue();
+  data_.append('{');
+  counts_.append(0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Closes the current object.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::endObject()
+{
+  endContainer('}');
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Opens an array.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::beginArray()
+{
+  beginValue();
+  data_.append('[');
+  counts_.append(0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Closes the current array.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::endArray()
+{
+  endContainer(']');
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes the name of the next member of the current object.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::name(const QString& name)
+{
+  beginValue();
+  appendString(name);
+  data_.append(format_ == Indented ? ": " : ":");
+  after_name_ = true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes a string value.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::value(const QString& value)
+{
+  beginValue();
+  appendString(value);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes a number value.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::value(qint64 value)
+{
+  beginValue();
+  data_.append(QByteArray::number(value));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes a fixed point number value: value / 10^decimals, so 1234 with two
+/// decimals is written as 12.34.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::value(qint64 value, int decimals)
+{
+  QByteArray digits = QByteArray::number(qAbs(value));
+
+  if(digits.size() <= decimals)
+    digits.prepend(QByteArray(decimals + 1 - digits.size(), '0'));
+
+  if(decimals > 0)
+    digits.insert(digits.size() - decimals, '.');
+
+  if(value < 0)
+    digits.prepend('-');
+
+  beginValue();
+  data_.append(digits);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the document written so far.
+///////////////////////////////////////////////////////////////////////////////
+QByteArray JsonWriter::data() const
+{
+  if(format_ == Indented && counts_.isEmpty() && !data_.isEmpty())
+    return data_ + '\n';
+
+  return data_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes whatever has to come before a value: nothing after a name,
+/// otherwise a separator if the container already has values.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::beginValue()
+{
+  if(after_name_) {
+    after_name_ = false;
+    return;
+  }
+
+  if(counts_.isEmpty())
+    return;
+
+  if(counts_.last()++)
+    data_.append(',');
+
+  newLine();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Closes the current container with c.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::endContainer(char c)
+{
+  int count = counts_.takeLast();
+
+  if(count)
+    newLine();
+
+  data_.append(c);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Starts a new, indented line if the format is indented.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::newLine()
+{
+  if(format_ != Indented)
+    return;
+
+  data_.append('\n');
+  data_.append(QByteArray(counts_.size() * 4, ' '));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Appends string quoted and escaped as utf-8.
+///////////////////////////////////////////////////////////////////////////////
+void JsonWriter::appendString(const QString& string)
+{
+  const char* Hex = "0123456789abcdef";
+  QByteArray utf8 = string.toUtf8();
+  const char* begin = utf8.constData();
+  const char* end = begin + utf8.size();
+
+  data_.append('"');
+
+  // Runs of characters that need no escaping are copied in one go.
+  for(const char* it = begin; it != end; ++it) {
+    uchar c = *it;
+
+    if(c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    data_.append(begin, it - begin);
+    begin = it + 1;
+
+    switch(c) {
+      case '"':  data_.append("\\\""); break;
+      case '\\': data_.append("\\\\"); break;
+      case '\b': data_.append("\\b"); break;
+      case '\f': data_.append("\\f"); break;
+      case '\n': data_.append("\\n"); break;
+      case '\r': data_.append("\\r"); break;
+      case '\t': data_.append("\\t"); break;
+
+      default:
+        data_.append("\\u00");
+        data_.append(Hex[c >> 4]);
+        data_.append(Hex[c & 0xf]);
+        break;
+    }
+  }
+
+  data_.append(begin, end - begin);
+  data_.append('"');
+}
+
+} // namespace jccu
@@ -0,0 +1,60 @@
+#ifndef JCCU_SOURCE_JSON_WRITER_H
+#define JCCU_SOURCE_JSON_WRITER_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Push writer for json.
+/// Appends tokens straight to a byte array, so the cost of writing is the
+/// cost of the bytes written; no document is built. The caller is trusted
+/// to write a well-formed document.
+///////////////////////////////////////////////////////////////////////////////
+class JsonWriter
+{
+  public:
+    enum Format {
+      Indented,
+      Compact
+    };
+
+    explicit JsonWriter(Format format = Indented);
+    ~JsonWriter();
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void name(const QString& name);
+    void value(const QString& value);
+    void value(qint64 value);
+    void value(qint64 value, int decimals);
+
+    QByteArray data() const;
+
+  private:
+    JsonWriter(const JsonWriter&);
+    JsonWriter& operator=(const JsonWriter&);
+
+    void beginValue();
+    void endContainer(char c);
+    void newLine();
+    void appendString(const QString& string);
+
+    QByteArray data_;
+    QVector<int> counts_; // Values written to each open container.
+    Format format_;
+    bool after_name_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_JSON_WRITER_H
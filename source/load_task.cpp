@@ -0,0 +1,210 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "load_task.h"
+
+#include <QFile>
+#include <QMetaObject>
+#include <QObject>
+#include "can_manager.h"
+#include "journal_manager.h"
+#include "json_manager.h"
+#include "metrics.h"
+#include "snapshot_manager.h"
+#include "trace.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+/// The managers are made here rather than in run, so they belong to the
+/// thread that takes them over.
+///////////////////////////////////////////////////////////////////////////////
+LoadTask::LoadTask(const QString& json_file_name,
+                   const QString& snapshot_file_name,
+                   const QString& journal_file_name,
+                   QObject* receiver)
+  : goods_(new GoodManager),
+    dates_(new DateManager),
+    cans_(new CanManager(goods_, dates_)),
+    json_file_name_(json_file_name),
+    snapshot_file_name_(snapshot_file_name),
+    journal_file_name_(journal_file_name),
+    from_snapshot_(false),
+    generation_(0),
+    journal_offset_(0),
+    replayed_size_(0),
+    receiver_(receiver)
+{
+  setAutoDelete(false);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+LoadTask::~LoadTask()
+{
+  delete cans_;
+  delete dates_;
+  delete goods_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Loads, then reports the result to the receiver, if any.
+///////////////////////////////////////////////////////////////////////////////
+void LoadTask::run()
+{
+  bool ok = load();
+
+  if(receiver_)
+    QMetaObject::invokeMethod(receiver_, "loadFinished",
+                              Qt::QueuedConnection, Q_ARG(bool, ok));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads the snapshot, unless the json file is newer or it's damaged, and
+/// then the json file. Both name the journal position they continue into,
+/// and the json file is only newer if it names a later one (a save wrote it
+/// but not the snapshot). A json file that names no position was edited
+/// by hand, so it's always read, and the journal isn't replayed on top.
+/// A json file that can't be read falls back to the snapshot, which with
+/// the journal after it holds everything up to the last save too.
+/// File times aren't looked at.
+/// Replaying here keeps the per-record work off the receiver's thread; it
+/// only has to swap the result in.
+/// Returns true if either was read, or if there's nothing to read yet.
+///////////////////////////////////////////////////////////////////////////////
+bool LoadTask::load()
+{
+  JCCU_TRACE("LoadTask::load");
+  LatencyTimer timer(Metrics::Load);
+
+  JsonManager json(json_file_name_, goods_, dates_, cans_);
+  SnapshotManager snapshot(snapshot_file_name_, goods_, dates_, cans_);
+
+  quint64 json_generation = 0;
+  qint64 json_journal_offset = 0;
+  bool json_positioned = JsonManager::ReadJournalPosition(
+                           json_file_name_,
+                           &json_generation,
+                           &json_journal_offset);
+
+  bool snapshot_damaged = false;
+  from_snapshot_ = false;
+
+  if(json_positioned || !QFile::exists(json_file_name_)) {
+    from_snapshot_ = snapshot.read(&generation_, &journal_offset_);
+    snapshot_damaged = !from_snapshot_;
+  }
+
+  if(from_snapshot_ && json_positioned) {
+    bool json_newer = json_generation > generation_ ||
+                      (json_generation == generation_ &&
+                       json_journal_offset > journal_offset_);
+
+    from_snapshot_ = !json_newer;
+  }
+
+  bool ok = from_snapshot_;
+
+  if(!ok) {
+    generation_ = 0;
+    journal_offset_ = 0;
+    ok = json.read(&generation_, &journal_offset_);
+  }
+
+  if(!ok && !snapshot_damaged) {
+    from_snapshot_ = snapshot.read(&generation_, &journal_offset_);
+    ok = from_snapshot_;
+  }
+
+  if(!ok) {
+    generation_ = 0;
+    journal_offset_ = 0;
+
+    // The first run starts out empty.
+    ok = !QFile::exists(json_file_name_) &&
+         !QFile::exists(snapshot_file_name_) &&
+         !QFile::exists(journal_file_name_);
+  }
+
+  replayed_size_ = 0;
+
+  if(generation_) {
+    JournalManager journal(journal_file_name_, goods_, dates_, cans_);
+    journal.replay(generation_, journal_offset_, &replayed_size_);
+  }
+
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the loaded goods.
+///////////////////////////////////////////////////////////////////////////////
+GoodManager* LoadTask::goodManager() const
+{
+  return goods_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the loaded dates.
+///////////////////////////////////////////////////////////////////////////////
+DateManager* LoadTask::dateManager() const
+{
+  return dates_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the loaded cans.
+///////////////////////////////////////////////////////////////////////////////
+CanManager* LoadTask::canManager() const
+{
+  return cans_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if the snapshot was read rather than the json file.
+///////////////////////////////////////////////////////////////////////////////
+bool LoadTask::fromSnapshot() const
+{
+  return from_snapshot_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the journal generation what was read continues into, or zero if
+/// the journal doesn't apply to it.
+///////////////////////////////////////////////////////////////////////////////
+quint64 LoadTask::generation() const
+{
+  return generation_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the journal offset what was read continues from.
+///////////////////////////////////////////////////////////////////////////////
+qint64 LoadTask::journalOffset() const
+{
+  return journal_offset_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns where replay left the current journal, for resuming it, or zero
+/// if replay didn't get to it.
+///////////////////////////////////////////////////////////////////////////////
+qint64 LoadTask::replayedSize() const
+{
+  return replayed_size_;
+}
+
+} // namespace jccu
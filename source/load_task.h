@@ -0,0 +1,67 @@
+#ifndef JCCU_SOURCE_LOAD_TASK_H
+#define JCCU_SOURCE_LOAD_TASK_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QRunnable>
+#include <QString>
+
+class QObject;
+
+namespace jccu
+{
+
+class GoodManager;
+class DateManager;
+class CanManager;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads the snapshot, or the json file if it's newer or the snapshot is
+/// damaged, into managers of its own, and replays the journal on top.
+/// Meant to be run on a worker thread; once finished, the receiver's
+/// loadFinished(bool) slot is invoked on its own thread, which can then
+/// swap the managers' contents into its own and resume the journal. The
+/// task isn't auto-deleted.
+///////////////////////////////////////////////////////////////////////////////
+class LoadTask : public QRunnable
+{
+  public:
+    LoadTask(const QString& json_file_name,
+             const QString& snapshot_file_name,
+             const QString& journal_file_name,
+             QObject* receiver = nullptr);
+    ~LoadTask();
+
+    void run();
+    bool load();
+
+    GoodManager* goodManager() const;
+    DateManager* dateManager() const;
+    CanManager* canManager() const;
+
+    bool fromSnapshot() const;
+    quint64 generation() const;
+    qint64 journalOffset() const;
+    qint64 replayedSize() const;
+
+  private:
+    LoadTask(const LoadTask&);
+    LoadTask& operator=(const LoadTask&);
+
+    GoodManager* goods_;
+    DateManager* dates_;
+    CanManager* cans_;
+    QString json_file_name_;
+    QString snapshot_file_name_;
+    QString journal_file_name_;
+    bool from_snapshot_;
+    quint64 generation_;
+    qint64 journal_offset_;
+    qint64 replayed_size_; // End of the current journal's last good record.
+    QObject* receiver_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_LOAD_TASK_H
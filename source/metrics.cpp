@@ -0,0 +1,372 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "metrics.h"
+
+#include <QSaveFile>
+#include "json_writer.h"
+
+namespace jccu
+{
+
+std::atomic<qint64> Metrics::Counters_[CounterCount];
+std::atomic<qint64> Metrics::DataCalls_[RoleSlotCount];
+Metrics::Histogram Metrics::Histograms_[LatencyCount];
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Adds a latency sample of nsecs nanoseconds.
+///////////////////////////////////////////////////////////////////////////////
+void Metrics::Record(Latency latency, qint64 nsecs)
+{
+  Histogram& histogram = Histograms_[latency];
+  int bucket = 0;
+
+  for(qint64 n = nsecs; n > 1; n >>= 1)
+    ++bucket;
+
+  histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  histogram.samples.fetch_add(1, std::memory_order_relaxed);
+  histogram.total.fetch_add(nsecs, std::memory_order_relaxed);
+
+  qint64 max = histogram.max.load(std::memory_order_relaxed);
+
+  while(nsecs > max &&
+        !histogram.max.compare_exchange_weak(max, nsecs,
+                                             std::memory_order_relaxed))
+    ;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the value of counter.
+///////////////////////////////////////////////////////////////////////////////
+qint64 Metrics::Count(Counter counter)
+{
+  return Counters_[counter].load(std::memory_order_relaxed);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of data() calls for role. Roles outside the counted
+/// ranges all share one count.
+///////////////////////////////////////////////////////////////////////////////
+qint64 Metrics::DataCalls(int role)
+{
+  return DataCalls_[RoleSlot(role)].load(std::memory_order_relaxed);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of samples of latency.
+///////////////////////////////////////////////////////////////////////////////
+qint64 Metrics::Samples(Latency latency)
+{
+  return Histograms_[latency].samples.load(std::memory_order_relaxed);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the sum of all samples of latency, in nanoseconds.
+///////////////////////////////////////////////////////////////////////////////
+qint64 Metrics::Total(Latency latency)
+{
+  return Histograms_[latency].total.load(std::memory_order_relaxed);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the longest sample of latency, in nanoseconds.
+///////////////////////////////////////////////////////////////////////////////
+qint64 Metrics::Max(Latency latency)
+{
+  return Histograms_[latency].max.load(std::memory_order_relaxed);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns an upper bound, in nanoseconds, on the given percentile of
+/// latency: the top of the bucket it falls in, capped at the maximum.
+/// Returns 0 if there are no samples.
+///////////////////////////////////////////////////////////////////////////////
+qint64 Metrics::Percentile(Latency latency, int percent)
+{
+  QVector<qint64> buckets = Buckets(latency);
+  qint64 samples = 0;
+
+  for(int i = 0; i < BucketCount; ++i)
+    samples += buckets.at(i);
+
+  if(!samples)
+    return 0;
+
+  const qint64 rank = qMax<qint64>(
+    1, (samples * qBound(0, percent, 100) + 99) / 100);
+  qint64 seen = 0;
+
+  // The top two buckets would overflow; the maximum is as good a bound.
+  for(int i = 0; i < BucketCount - 2; ++i) {
+    seen += buckets.at(i);
+
+    if(seen >= rank)
+      return qMin(qint64(2) << i, Max(latency));
+  }
+
+  return Max(latency);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the BucketCount sample counts of latency.
+///////////////////////////////////////////////////////////////////////////////
+QVector<qint64> Metrics::Buckets(Latency latency)
+{
+  QVector<qint64> buckets(BucketCount);
+
+  for(int i = 0; i < BucketCount; ++i)
+    buckets[i] = Histograms_[latency].buckets[i].load(
+                   std::memory_order_relaxed);
+
+  return buckets;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the name of counter, as used in the json.
+///////////////////////////////////////////////////////////////////////////////
+const char* Metrics::CounterName(Counter counter)
+{
+  switch(counter) {
+    case Sorts:        return "sorts";
+    case RowsInserted: return "rowsInserted";
+    case RowsRemoved:  return "rowsRemoved";
+    case Saves:        return "saves";
+    case BytesWritten: return "bytesWritten";
+    default:           return "";
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the name of latency, as used in the json.
+///////////////////////////////////////////////////////////////////////////////
+const char* Metrics::LatencyName(Latency latency)
+{
+  switch(latency) {
+    case Load:     return "load";
+    case Save:     return "save";
+    case Sort:     return "sort";
+    case BulkEdit: return "bulkEdit";
+    default:       return "";
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Zeroes every counter and histogram.
+///////////////////////////////////////////////////////////////////////////////
+void Metrics::Reset()
+{
+  for(int i = 0; i < CounterCount; ++i)
+    Counters_[i].store(0, std::memory_order_relaxed);
+
+  for(int i = 0; i < RoleSlotCount; ++i)
+    DataCalls_[i].store(0, std::memory_order_relaxed);
+
+  for(int i = 0; i < LatencyCount; ++i) {
+    Histogram& histogram = Histograms_[i];
+
+    for(int j = 0; j < BucketCount; ++j)
+      histogram.buckets[j].store(0, std::memory_order_relaxed);
+
+    histogram.samples.store(0, std::memory_order_relaxed);
+    histogram.total.store(0, std::memory_order_relaxed);
+    histogram.max.store(0, std::memory_order_relaxed);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns a plain text table of everything, for showing to the user.
+/// Only roles that have been asked for are listed.
+///////////////////////////////////////////////////////////////////////////////
+QString Metrics::Report()
+{
+  auto Milliseconds = [](qint64 nsecs) -> QString {
+    return QString::number(nsecs / 1e6, 'f', 3).rightJustified(10);
+  };
+
+  QString report = "Counters\n";
+
+  for(int i = 0; i < CounterCount; ++i)
+    report += QString("  %1 %2\n")
+              .arg(CounterName(Counter(i)), -24)
+              .arg(Count(Counter(i)), 12);
+
+  report += "\ndata() calls\n";
+
+  for(int i = 0; i < RoleSlotCount; ++i) {
+    qint64 calls = DataCalls_[i].load(std::memory_order_relaxed);
+
+    if(calls)
+      report += QString("  %1 %2\n").arg(RoleName(i), -24).arg(calls, 12);
+  }
+
+  report += QString("\nLatency (ms)  %1 %2 %3 %4 %5 %6\n")
+            .arg("samples", 8)
+            .arg("mean", 10)
+            .arg("p50", 10)
+            .arg("p90", 10)
+            .arg("p99", 10)
+            .arg("max", 10);
+
+  for(int i = 0; i < LatencyCount; ++i) {
+    Latency latency = Latency(i);
+    qint64 samples = Samples(latency);
+
+    report += QString("  %1 %2 %3 %4 %5 %6 %7\n")
+              .arg(LatencyName(latency), -11)
+              .arg(samples, 8)
+              .arg(Milliseconds(samples ? Total(latency) / samples : 0))
+              .arg(Milliseconds(Percentile(latency, 50)))
+              .arg(Milliseconds(Percentile(latency, 90)))
+              .arg(Milliseconds(Percentile(latency, 99)))
+              .arg(Milliseconds(Max(latency)));
+  }
+
+  return report;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns everything as json:
+/// {"counters": {"sorts": n, ...},
+///  "dataCalls": {"DisplayRole": n, ...},
+///  "latencies": {"load": {"samples": n, "totalNs": n, "maxNs": n,
+///                         "p50Ns": n, "p90Ns": n, "p99Ns": n,
+///                         "buckets": [[lowest ns, samples], ...]}, ...}}
+/// Only roles that have been asked for and buckets with samples are listed.
+///////////////////////////////////////////////////////////////////////////////
+QByteArray Metrics::Json()
+{
+  JsonWriter writer(JsonWriter::Indented);
+  writer.beginObject();
+
+  writer.name("counters");
+  writer.beginObject();
+
+  for(int i = 0; i < CounterCount; ++i) {
+    writer.name(CounterName(Counter(i)));
+    writer.value(Count(Counter(i)));
+  }
+
+  writer.endObject();
+
+  writer.name("dataCalls");
+  writer.beginObject();
+
+  for(int i = 0; i < RoleSlotCount; ++i) {
+    qint64 calls = DataCalls_[i].load(std::memory_order_relaxed);
+
+    if(!calls)
+      continue;
+
+    writer.name(RoleName(i));
+    writer.value(calls);
+  }
+
+  writer.endObject();
+
+  writer.name("latencies");
+  writer.beginObject();
+
+  for(int i = 0; i < LatencyCount; ++i) {
+    Latency latency = Latency(i);
+    QVector<qint64> buckets = Buckets(latency);
+
+    writer.name(LatencyName(latency));
+    writer.beginObject();
+    writer.name("samples");
+    writer.value(Samples(latency));
+    writer.name("totalNs");
+    writer.value(Total(latency));
+    writer.name("maxNs");
+    writer.value(Max(latency));
+    writer.name("p50Ns");
+    writer.value(Percentile(latency, 50));
+    writer.name("p90Ns");
+    writer.value(Percentile(latency, 90));
+    writer.name("p99Ns");
+    writer.value(Percentile(latency, 99));
+    writer.name("buckets");
+    writer.beginArray();
+
+    for(int j = 0; j < BucketCount; ++j) {
+      if(!buckets.at(j))
+        continue;
+
+      writer.beginArray();
+      writer.value(j ? qint64(1) << j : 0);
+      writer.value(buckets.at(j));
+      writer.endArray();
+    }
+
+    writer.endArray();
+    writer.endObject();
+  }
+
+  writer.endObject();
+  writer.endObject();
+
+  return writer.data();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes Json() out to file_name.
+/// Returns true if the file was written.
+///////////////////////////////////////////////////////////////////////////////
+bool Metrics::Write(const QString& file_name)
+{
+  QSaveFile file(file_name);
+
+  if(!file.open(QSaveFile::WriteOnly))
+    return false;
+
+  file.write(Json());
+
+  if(!file.commit())
+    return false;
+
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the name of the role counted in DataCalls_ slot.
+///////////////////////////////////////////////////////////////////////////////
+QString Metrics::RoleName(int slot)
+{
+  static const char* const Names[] = {
+    "DisplayRole", "DecorationRole", "EditRole", "ToolTipRole",
+    "StatusTipRole", "WhatsThisRole", "FontRole", "TextAlignmentRole",
+    "BackgroundRole", "ForegroundRole", "CheckStateRole",
+    "AccessibleTextRole", "AccessibleDescriptionRole", "SizeHintRole",
+    "InitialSortOrderRole"
+  };
+
+  const int name_count = sizeof(Names) / sizeof(Names[0]);
+
+  if(slot < name_count)
+    return Names[slot];
+
+  if(slot < QtRoleCount)
+    return QString("Role%1").arg(slot);
+
+  if(slot < RoleSlotCount - 1)
+    return QString("UserRole+%1").arg(slot - QtRoleCount);
+
+  return "OtherRoles";
+}
+
+} // namespace jccu
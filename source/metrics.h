@@ -0,0 +1,155 @@
+#ifndef JCCU_SOURCE_METRICS_H
+#define JCCU_SOURCE_METRICS_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <atomic>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Always-on counters and latency histograms.
+/// Everything is a relaxed atomic add, so it's safe from any thread and
+/// cheap enough to leave in data(). Latencies are bucketed by powers of two
+/// nanoseconds: bucket n holds latencies in [2^n, 2^(n+1)).
+/// Rows inserted and removed are the rows views are told about, so bulk
+/// loads, which reset the model, aren't counted.
+///////////////////////////////////////////////////////////////////////////////
+class Metrics
+{
+  public:
+    enum Counter {
+      Sorts,
+      RowsInserted,
+      RowsRemoved,
+      Saves,
+      BytesWritten,
+      CounterCount
+    };
+
+    enum Latency {
+      Load,
+      Save,
+      Sort,
+      BulkEdit,
+      LatencyCount
+    };
+
+    static const int BucketCount = 64;
+
+    static void Add(Counter counter, qint64 amount = 1);
+    static void AddDataCall(int role);
+    static void Record(Latency latency, qint64 nsecs);
+
+    static qint64 Count(Counter counter);
+    static qint64 DataCalls(int role);
+    static qint64 Samples(Latency latency);
+    static qint64 Total(Latency latency);
+    static qint64 Max(Latency latency);
+    static qint64 Percentile(Latency latency, int percent);
+    static QVector<qint64> Buckets(Latency latency);
+
+    static const char* CounterName(Counter counter);
+    static const char* LatencyName(Latency latency);
+
+    static void Reset();
+    static QString Report();
+    static QByteArray Json();
+    static bool Write(const QString& file_name);
+
+  private:
+    Metrics();
+    Metrics(const Metrics&);
+    Metrics& operator=(const Metrics&);
+
+    static int RoleSlot(int role);
+    static QString RoleName(int slot);
+
+    struct Histogram {
+      std::atomic<qint64> buckets[BucketCount];
+      std::atomic<qint64> samples;
+      std::atomic<qint64> total;
+      std::atomic<qint64> max;
+    };
+
+    // Qt's own roles get the first QtRoleCount slots and user roles the
+    // rest, except for the last slot, which counts every role in neither.
+    static const int QtRoleCount = 32;
+    static const int RoleSlotCount = 64;
+
+    static std::atomic<qint64> Counters_[CounterCount];
+    static std::atomic<qint64> DataCalls_[RoleSlotCount];
+    static Histogram Histograms_[LatencyCount];
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records the time from construction to destruction as a latency sample.
+///////////////////////////////////////////////////////////////////////////////
+class LatencyTimer
+{
+  public:
+    explicit LatencyTimer(Metrics::Latency latency)
+      : latency_(latency)
+    {
+      timer_.start();
+    }
+
+    ~LatencyTimer()
+    {
+      Metrics::Record(latency_, timer_.nsecsElapsed());
+    }
+
+  private:
+    LatencyTimer(const LatencyTimer&);
+    LatencyTimer& operator=(const LatencyTimer&);
+
+    Metrics::Latency latency_;
+    QElapsedTimer timer_;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Adds amount to counter. Inline, since rows are counted one edit at a
+/// time.
+///////////////////////////////////////////////////////////////////////////////
+inline void Metrics::Add(Counter counter, qint64 amount)
+{
+  Counters_[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Counts a data() call for role. Inline, since views call data() for every
+/// role of every visible cell.
+///////////////////////////////////////////////////////////////////////////////
+inline void Metrics::AddDataCall(int role)
+{
+  DataCalls_[RoleSlot(role)].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the DataCalls_ slot that counts role.
+///////////////////////////////////////////////////////////////////////////////
+inline int Metrics::RoleSlot(int role)
+{
+  if(role >= 0 && role < QtRoleCount)
+    return role;
+
+  const int user_role = role - Qt::UserRole;
+
+  if(user_role >= 0 && user_role < RoleSlotCount - QtRoleCount - 1)
+    return QtRoleCount + user_role;
+
+  return RoleSlotCount - 1;
+}
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_METRICS_H
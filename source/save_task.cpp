@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "save_task.h"
+
+#include <QMetaObject>
+#include <QObject>
+#include "json_manager.h"
+#include "metrics.h"
+#include "snapshot_manager.h"
+#include "trace.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+///////////////////////////////////////////////////////////////////////////////
+SaveTask::SaveTask(const Inventory& inventory,
+                   const QString& json_file_name,
+                   const QString& snapshot_file_name,
+                   quint64 generation,
+                   qint64 journal_offset,
+                   QObject* receiver)
+  : inventory_(inventory),
+    json_file_name_(json_file_name),
+    snapshot_file_name_(snapshot_file_name),
+    generation_(generation),
+    journal_offset_(journal_offset),
+    receiver_(receiver)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+SaveTask::~SaveTask()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Saves, then reports the result to the receiver, if any.
+///////////////////////////////////////////////////////////////////////////////
+void SaveTask::run()
+{
+  bool ok = save();
+
+  if(receiver_)
+    QMetaObject::invokeMethod(receiver_, "saveFinished",
+                              Qt::QueuedConnection, Q_ARG(bool, ok));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes the snapshot and then the json file, both naming the same journal
+/// position. If only the snapshot makes it, the json file still names an
+/// older position and the snapshot is loaded; if only the json file does,
+/// it names the newer one and is loaded instead. Either way the journal
+/// replays from there.
+/// Returns true if both were written.
+///////////////////////////////////////////////////////////////////////////////
+bool SaveTask::save() const
+{
+  JCCU_TRACE("SaveTask::save");
+  LatencyTimer timer(Metrics::Save);
+  Metrics::Add(Metrics::Saves);
+
+  bool snapshot_ok = SnapshotManager::Write(snapshot_file_name_,
+                                            inventory_,
+                                            generation_,
+                                            journal_offset_);
+  bool json_ok = JsonManager::Write(json_file_name_,
+                                    inventory_,
+                                    generation_,
+                                    journal_offset_);
+
+  return snapshot_ok && json_ok;
+}
+
+} // namespace jccu
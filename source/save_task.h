@@ -0,0 +1,49 @@
+#ifndef JCCU_SOURCE_SAVE_TASK_H
+#define JCCU_SOURCE_SAVE_TASK_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QRunnable>
+#include <QString>
+#include "inventory.h"
+
+class QObject;
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes an inventory out to the snapshot and then the json file.
+/// Meant to be run on a worker thread; once finished, the receiver's
+/// saveFinished(bool) slot is invoked on its own thread.
+///////////////////////////////////////////////////////////////////////////////
+class SaveTask : public QRunnable
+{
+  public:
+    SaveTask(const Inventory& inventory,
+             const QString& json_file_name,
+             const QString& snapshot_file_name,
+             quint64 generation,
+             qint64 journal_offset,
+             QObject* receiver = nullptr);
+    ~SaveTask();
+
+    void run();
+    bool save() const;
+
+  private:
+    SaveTask(const SaveTask&);
+    SaveTask& operator=(const SaveTask&);
+
+    Inventory inventory_;
+    QString json_file_name_;
+    QString snapshot_file_name_;
+    quint64 generation_;
+    qint64 journal_offset_;
+    QObject* receiver_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_SAVE_TASK_H
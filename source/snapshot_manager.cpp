@@ -0,0 +1,313 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "snapshot_manager.h"
+
+#include <string.h>
+#include <QByteArray>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+#include "can_manager.h"
+#include "inventory.h"
+#include "metrics.h"
+#include "trace.h"
+
+namespace jccu
+{
+
+const char SnapshotManager::Magic[4] = {'J', 'C', 'C', 'S'};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+///////////////////////////////////////////////////////////////////////////////
+SnapshotManager::SnapshotManager(const QString& file_name,
+                                 GoodManager* good_manager,
+                                 DateManager* date_manager,
+                                 CanManager* can_manager)
+  : file_name_(file_name),
+    goods_(good_manager),
+    dates_(date_manager),
+    cans_(can_manager)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+SnapshotManager::~SnapshotManager()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reads in data from the snapshot.
+/// The file is mapped rather than read. If it's damaged in any way, nothing
+/// is loaded and false is returned.
+/// Outputs the snapshot's generation and journal offset to generation and
+/// journal_offset, if they're non-null.
+///////////////////////////////////////////////////////////////////////////////
+bool SnapshotManager::read(quint64* generation, qint64* journal_offset)
+{
+  JCCU_TRACE("SnapshotManager::read");
+
+  if(!valid())
+    return false;
+
+  QFile file(file_name_);
+
+  if(!file.open(QFile::ReadOnly))
+    return false;
+
+  qint64 size = file.size();
+
+  if(size < HeaderSize)
+    return false;
+
+  const uchar* data = file.map(0, size);
+
+  if(!data)
+    return false;
+
+  bool ok = load(data, size, generation, journal_offset);
+  file.unmap(const_cast<uchar*>(data));
+
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes data out to the snapshot, tagged with the given generation and
+/// journal offset.
+///////////////////////////////////////////////////////////////////////////////
+bool SnapshotManager::write(quint64 generation, qint64 journal_offset) const
+{
+  if(!valid())
+    return false;
+
+  return Write(file_name_,
+               Inventory(goods_, dates_, cans_),
+               generation,
+               journal_offset);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the name of the snapshot file.
+///////////////////////////////////////////////////////////////////////////////
+const QString& SnapshotManager::fileName() const
+{
+  return file_name_;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Writes inventory out to the snapshot file file_name, tagged with the
+/// given generation and journal offset.
+/// Only reads inventory, so it's safe to call from any thread.
+///////////////////////////////////////////////////////////////////////////////
+bool SnapshotManager::Write(const QString& file_name,
+                            const Inventory& inventory,
+                            quint64 generation,
+                            qint64 journal_offset)
+{
+  JCCU_TRACE("SnapshotManager::Write");
+
+  const int goods_count = inventory.goods().size();
+  const int dates_count = inventory.dates().size();
+  const int cans_count = inventory.canGoodIds().size();
+
+  QByteArray strings;
+  QByteArray goods(goods_count * GoodSize, Qt::Uninitialized);
+  uchar* pos = reinterpret_cast<uchar*>(goods.data());
+
+  auto good_it = inventory.goods().constBegin(),
+       good_end = inventory.goods().constEnd();
+
+  for(; good_it != good_end; ++good_it) {
+    QByteArray good = good_it.value().toUtf8();
+
+    qToLittleEndian<qint32>(good_it.key(), pos);
+    qToLittleEndian<quint32>(strings.size(), pos + 4);
+    qToLittleEndian<quint32>(good.size(), pos + 8);
+    pos += GoodSize;
+
+    strings.append(good);
+  }
+
+  QByteArray dates(dates_count * DateSize, Qt::Uninitialized);
+  pos = reinterpret_cast<uchar*>(dates.data());
+
+  auto date_it = inventory.dates().constBegin(),
+       date_end = inventory.dates().constEnd();
+
+  for(; date_it != date_end; ++date_it) {
+    qToLittleEndian<qint32>(date_it.key(), pos);
+    qToLittleEndian<qint64>(date_it.value(), pos + 4);
+    pos += DateSize;
+  }
+
+  QByteArray cans(cans_count * CanSize, Qt::Uninitialized);
+  pos = reinterpret_cast<uchar*>(cans.data());
+
+  auto can_it = inventory.canGoodIds().constBegin(),
+       can_end = inventory.canGoodIds().constEnd();
+
+  for(; can_it != can_end; ++can_it) {
+    int date_id = inventory.canDateIds().value(can_it.key());
+    int quantity = inventory.canQuantities().value(can_it.key(), 1);
+
+    qToLittleEndian<qint32>(can_it.key(), pos);
+    qToLittleEndian<qint32>(can_it.value(), pos + 4);
+    qToLittleEndian<qint32>(date_id, pos + 8);
+    qToLittleEndian<qint32>(quantity, pos + 12);
+    pos += CanSize;
+  }
+
+  QByteArray header(HeaderSize, Qt::Uninitialized);
+  pos = reinterpret_cast<uchar*>(header.data());
+
+  memcpy(pos, Magic, sizeof(Magic));
+  qToLittleEndian<quint32>(Version, pos + 4);
+  qToLittleEndian<quint64>(generation, pos + 8);
+  qToLittleEndian<qint64>(journal_offset, pos + 16);
+  qToLittleEndian<quint32>(goods_count, pos + 24);
+  qToLittleEndian<quint32>(strings.size(), pos + 28);
+  qToLittleEndian<quint32>(dates_count, pos + 32);
+  qToLittleEndian<quint32>(cans_count, pos + 36);
+
+  QSaveFile file(file_name);
+
+  if(!file.open(QSaveFile::WriteOnly))
+    return false;
+
+  file.write(header);
+  file.write(goods);
+  file.write(strings);
+  file.write(dates);
+  file.write(cans);
+
+  if(!file.commit())
+    return false;
+
+  Metrics::Add(Metrics::BytesWritten, header.size() + goods.size() +
+                                      strings.size() + dates.size() +
+                                      cans.size());
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Validates and loads the size bytes of snapshot at data.
+/// Section sizes are checked against the file size up front; each record is
+/// then checked as it's inserted.
+///////////////////////////////////////////////////////////////////////////////
+bool SnapshotManager::load(const uchar* data,
+                           qint64 size,
+                           quint64* generation,
+                           qint64* journal_offset)
+{
+  if(memcmp(data, Magic, sizeof(Magic)) != 0)
+    return false;
+
+  const quint32 version = qFromLittleEndian<quint32>(data + 4);
+
+  if(version != Version)
+    return false;
+
+  const qint64 goods_count = qFromLittleEndian<quint32>(data + 24);
+  const qint64 strings_size = qFromLittleEndian<quint32>(data + 28);
+  const qint64 dates_count = qFromLittleEndian<quint32>(data + 32);
+  const qint64 cans_count = qFromLittleEndian<quint32>(data + 36);
+
+  const qint64 expected_size = HeaderSize +
+                               goods_count * GoodSize +
+                               strings_size +
+                               dates_count * DateSize +
+                               cans_count * CanSize;
+
+  if(size != expected_size)
+    return false;
+
+  const uchar* goods = data + HeaderSize;
+  const char* strings = reinterpret_cast<const char*>(
+    goods + goods_count * GoodSize);
+  const uchar* dates = reinterpret_cast<const uchar*>(strings) + strings_size;
+  const uchar* cans = dates + dates_count * DateSize;
+
+  goods_->beginBulkLoad();
+  dates_->beginBulkLoad();
+  cans_->beginBulkLoad();
+
+  bool ok = true;
+
+  for(qint64 i = 0; ok && i < goods_count; ++i, goods += GoodSize) {
+    int good_id = qFromLittleEndian<qint32>(goods);
+    qint64 offset = qFromLittleEndian<quint32>(goods + 4);
+    qint64 length = qFromLittleEndian<quint32>(goods + 8);
+
+    if(offset + length > strings_size) {
+      ok = false;
+      break;
+    }
+
+    QString good = QString::fromUtf8(strings + offset, length);
+    ok = goods_->insert(good_id, good);
+  }
+
+  for(qint64 i = 0; ok && i < dates_count; ++i, dates += DateSize) {
+    int date_id = qFromLittleEndian<qint32>(dates);
+    int64_t date = qFromLittleEndian<qint64>(dates + 4);
+    ok = dates_->insert(date_id, date);
+  }
+
+  for(qint64 i = 0; ok && i < cans_count; ++i, cans += CanSize) {
+    int can_id = qFromLittleEndian<qint32>(cans);
+    int good_id = qFromLittleEndian<qint32>(cans + 4);
+    int date_id = qFromLittleEndian<qint32>(cans + 8);
+    int quantity = qFromLittleEndian<qint32>(cans + 12);
+
+    ok = cans_->insert(can_id, good_id, date_id, quantity);
+  }
+
+  goods_->endBulkLoad();
+  dates_->endBulkLoad();
+
+  // Unlike json, a snapshot is only ever written by us; a can that refers
+  // to something missing means the file is damaged.
+  if(cans_->endBulkLoad() != 0)
+    ok = false;
+
+  if(!ok) {
+    cans_->clear();
+    dates_->clear();
+    goods_->clear();
+  }
+
+  if(ok && generation)
+    *generation = qFromLittleEndian<quint64>(data + 8);
+
+  if(ok && journal_offset)
+    *journal_offset = qFromLittleEndian<qint64>(data + 16);
+
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if the manager is in a valid state.
+///////////////////////////////////////////////////////////////////////////////
+bool SnapshotManager::valid() const
+{
+  if(file_name_.isEmpty())
+    return false;
+
+  if(!goods_ || !dates_ || !cans_)
+    return false;
+
+  return true;
+}
+
+} // namespace jccu
@@ -0,0 +1,76 @@
+#ifndef JCCU_SOURCE_SNAPSHOT_MANAGER_H
+#define JCCU_SOURCE_SNAPSHOT_MANAGER_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QString>
+
+namespace jccu
+{
+
+class GoodManager;
+class DateManager;
+class CanManager;
+class Inventory;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Manages binary snapshot reading and writing.
+/// A snapshot holds the same data as the json file in a form that can be
+/// mapped and loaded with a single validation pass. All fields are little
+/// endian. The generation and journal offset say where in which journal
+/// replay has to start:
+///
+///   header   "JCCS", version (2 x 4 bytes), generation, journal offset
+///            (2 x 8 bytes), good count, string table size, date count, can
+///            count (4 x 4 bytes)
+///   goods    good id, string offset, string size (3 x 4 bytes each)
+///   strings  utf-8 good names, referenced by the goods
+///   dates    date id (4 bytes), julian day (8 bytes) each
+///   cans     can id, good id, date id, quantity (4 x 4 bytes each)
+///////////////////////////////////////////////////////////////////////////////
+class SnapshotManager
+{
+  public:
+    SnapshotManager(const QString& file_name,
+                    GoodManager* good_manager,
+                    DateManager* date_manager,
+                    CanManager* can_manager);
+    ~SnapshotManager();
+
+    bool read(quint64* generation = nullptr, qint64* journal_offset = nullptr);
+    bool write(quint64 generation = 0, qint64 journal_offset = 0) const;
+
+    const QString& fileName() const;
+
+    static bool Write(const QString& file_name,
+                      const Inventory& inventory,
+                      quint64 generation,
+                      qint64 journal_offset);
+
+  private:
+    SnapshotManager(const SnapshotManager&);
+    SnapshotManager& operator=(const SnapshotManager&);
+
+    bool load(const uchar* data,
+              qint64 size,
+              quint64* generation,
+              qint64* journal_offset);
+    bool valid() const;
+
+    static const char Magic[4];
+    static const quint32 Version = 4;
+    static const int HeaderSize = 2 * 4 + 2 * 8 + 4 * 4;
+    static const int GoodSize = 3 * 4;
+    static const int DateSize = 4 + 8;
+    static const int CanSize = 4 * 4;
+
+    QString file_name_;
+    GoodManager* goods_;
+    DateManager* dates_;
+    CanManager* cans_;
+};
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_SNAPSHOT_MANAGER_H
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include "json_writer.h"
+
+namespace jccu
+{
+
+QAtomicInt Tracer::Enabled_(0);
+QElapsedTimer Tracer::Clock_;
+QMutex Tracer::Mutex_;
+QVector<Tracer::Event> Tracer::Events_;
+QString Tracer::FileName_;
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Starts recording spans, to be written to file_name by Stop.
+///////////////////////////////////////////////////////////////////////////////
+void Tracer::Start(const QString& file_name)
+{
+  QMutexLocker locker(&Mutex_);
+
+  FileName_ = file_name;
+  Events_.clear();
+  Clock_.start();
+  Enabled_.store(1);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Stops recording and writes the spans recorded since Start.
+/// Spans still open at this point aren't written.
+/// Returns true if the file was written.
+///////////////////////////////////////////////////////////////////////////////
+bool Tracer::Stop()
+{
+  QMutexLocker locker(&Mutex_);
+
+  if(!Enabled_.load())
+    return false;
+
+  Enabled_.store(0);
+
+  JsonWriter writer(JsonWriter::Compact);
+  writer.beginObject();
+  writer.name("traceEvents");
+  writer.beginArray();
+
+  const qint64 pid = QCoreApplication::applicationPid();
+
+  auto it = Events_.constBegin(),
+       end = Events_.constEnd();
+
+  // Complete ("X") events; times are in microseconds.
+  for(; it != end; ++it) {
+    writer.beginObject();
+    writer.name("name");
+    writer.value(QString::fromLatin1(it->name));
+    writer.name("cat");
+    writer.value(QString("jccu"));
+    writer.name("ph");
+    writer.value(QString("X"));
+    writer.name("pid");
+    writer.value(pid);
+    writer.name("tid");
+    writer.value(it->thread);
+    writer.name("ts");
+    writer.value(it->start, 3);
+    writer.name("dur");
+    writer.value(it->end - it->start, 3);
+    writer.endObject();
+  }
+
+  writer.endArray();
+  writer.endObject();
+
+  Events_.clear();
+
+  QSaveFile file(FileName_);
+
+  if(!file.open(QSaveFile::WriteOnly))
+    return false;
+
+  file.write(writer.data());
+
+  if(!file.commit())
+    return false;
+
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the time in nanoseconds since Start.
+///////////////////////////////////////////////////////////////////////////////
+qint64 Tracer::Now()
+{
+  return Clock_.nsecsElapsed();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records a span called name on the calling thread.
+///////////////////////////////////////////////////////////////////////////////
+void Tracer::Record(const char* name, qint64 start, qint64 end)
+{
+  Event event = {
+    name,
+    start,
+    end,
+    static_cast<qint64>(
+      reinterpret_cast<quintptr>(QThread::currentThreadId()))
+  };
+
+  QMutexLocker locker(&Mutex_);
+
+  if(!Enabled_.load() || Events_.size() >= MaxEvents)
+    return;
+
+  Events_.append(event);
+}
+
+} // namespace jccu
@@ -0,0 +1,101 @@
+#ifndef JCCU_SOURCE_TRACE_H
+#define JCCU_SOURCE_TRACE_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// Traces the rest of the enclosing scope as a span called name, which must
+/// be a string literal. Costs one relaxed load while tracing is off.
+///////////////////////////////////////////////////////////////////////////////
+#define JCCU_TRACE(name) \
+  jccu::TraceScope JCCU_TRACE_JOIN(trace_scope_, __LINE__)(name)
+
+#define JCCU_TRACE_JOIN(a, b) JCCU_TRACE_JOIN_AGAIN(a, b)
+#define JCCU_TRACE_JOIN_AGAIN(a, b) a##b
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Collects trace spans and writes them out in the Chrome trace event
+/// format, which chrome://tracing and Perfetto open.
+/// Spans can be recorded from any thread. Once MaxEvents spans have been
+/// recorded, the rest are dropped.
+///////////////////////////////////////////////////////////////////////////////
+class Tracer
+{
+  public:
+    static void Start(const QString& file_name);
+    static bool Stop();
+
+    static bool Enabled();
+    static qint64 Now();
+    static void Record(const char* name, qint64 start, qint64 end);
+
+  private:
+    Tracer();
+    Tracer(const Tracer&);
+    Tracer& operator=(const Tracer&);
+
+    struct Event {
+      const char* name;
+      qint64 start; // Nanoseconds since Start.
+      qint64 end;
+      qint64 thread;
+    };
+
+    static const int MaxEvents = 1 << 20;
+
+    static QAtomicInt Enabled_;
+    static QElapsedTimer Clock_;
+    static QMutex Mutex_;
+    static QVector<Event> Events_;
+    static QString FileName_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// Records a span from construction to destruction. Use JCCU_TRACE.
+///////////////////////////////////////////////////////////////////////////////
+class TraceScope
+{
+  public:
+    explicit TraceScope(const char* name)
+      : name_(Tracer::Enabled() ? name : nullptr),
+        start_(name_ ? Tracer::Now() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+      if(name_)
+        Tracer::Record(name_, start_, Tracer::Now());
+    }
+
+  private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+    const char* name_;
+    qint64 start_;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true while spans are being recorded. Inline, since every traced
+/// scope asks.
+///////////////////////////////////////////////////////////////////////////////
+inline bool Tracer::Enabled()
+{
+  return Enabled_.load() != 0;
+}
+
+} // namespace jccu
+
+#endif // JCCU_SOURCE_TRACE_H
@@ -3,20 +3,30 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include "window.h"
 
+#include <limits>
 #include <QAction>
 #include <QApplication>
+#include <QCheckBox>
 #include <QComboBox>
 #include <QContextMenuEvent>
+#include <QDateEdit>
 #include <QEvent>
 #include <QInputDialog>
+#include <QItemSelection>
+#include <QLineEdit>
 #include <QMenu>
 #include <QMessageBox>
+#include <QStringList>
 #include <QWidget>
 #include "application.h"
 #include "calendar_dialog.h"
+#include "can_filter_model.h"
 #include "can_manager.h"
+#include "diagnostics_dialog.h"
 #include "edit_date_dialog.h"
 #include "edit_good_dialog.h"
+#include "good_completer.h"
+#include "good_manager.h"
 #include "ui_Window.h"
 
 namespace jccu
@@ -42,32 +52,76 @@ Window::Window()
   remove->setObjectName("actionRemoveCan");
   remove->setText("&Remove");
 
+  QAction* takeOne = new QAction(can_context_menu_);
+  takeOne->setObjectName("actionTakeOne");
+  takeOne->setText("&Take one");
+
+  QAction* splitLot = new QAction(can_context_menu_);
+  splitLot->setObjectName("actionSplitLot");
+  splitLot->setText("&Split off one");
+
   can_context_menu_->addAction(editGood);
   can_context_menu_->addAction(editDate);
   can_context_menu_->addAction(remove);
+  can_context_menu_->addSeparator();
+  can_context_menu_->addAction(takeOne);
+  can_context_menu_->addAction(splitLot);
 
   // Perform all manual ui setup before this. Then we don't have to make an
   // explicit call to connectSlotsByName.
   ui_->setupUi(this);
 
   auto good_manager = Application::Instance()->goodManager();
+  auto date_manager = Application::Instance()->dateManager();
   auto can_manager = Application::Instance()->canManager();
 
+  can_filter_model_ = new CanFilterModel(can_manager,
+                                         good_manager,
+                                         date_manager,
+                                         this);
+
   connect(ui_->actionQuit, &QAction::triggered,
           qApp, &QApplication::quit);
 
   ui_->addGoodComboBox->setModel(good_manager);
   ui_->addGoodComboBox->setModelColumn(1);
+  new GoodCompleter(ui_->addGoodComboBox);
   ui_->dateDateEdit->setDate(QDate::currentDate());
 
   ui_->removeGoodComboBox->setModel(good_manager);
   ui_->removeGoodComboBox->setModelColumn(1);
+  new GoodCompleter(ui_->removeGoodComboBox);
 
   ui_->tableView->installEventFilter(this); // Catch context menu events.
-  ui_->tableView->setModel(can_manager);
+  ui_->tableView->setModel(can_filter_model_);
   ui_->tableView->horizontalHeader()
                 ->setSectionResizeMode(QHeaderView::Stretch);
 
+  connect(ui_->searchLineEdit, &QLineEdit::textChanged,
+          [this](const QString& text) {
+    can_filter_model_->setGoodFilter(text);
+  });
+
+  connect(ui_->expiresComboBox,
+          static_cast<void (QComboBox::*)(int)>(
+            &QComboBox::currentIndexChanged),
+          [this](int index) {
+    can_filter_model_->setExpiryBand(
+      static_cast<CanFilterModel::ExpiryBand>(index));
+  });
+
+  ui_->fromDateEdit->setDate(QDate::currentDate());
+  ui_->toDateEdit->setDate(QDate::currentDate().addDays(30));
+
+  connect(ui_->fromCheckBox, &QCheckBox::toggled,
+          [this]() { updateExpiryRange(); });
+  connect(ui_->fromDateEdit, &QDateEdit::dateChanged,
+          [this]() { updateExpiryRange(); });
+  connect(ui_->toCheckBox, &QCheckBox::toggled,
+          [this]() { updateExpiryRange(); });
+  connect(ui_->toDateEdit, &QDateEdit::dateChanged,
+          [this]() { updateExpiryRange(); });
+
   setWindowTitle("jccu " + Application::Version());
 }
 
@@ -81,6 +135,20 @@ Window::~Window()
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// Disables editing and says so in the status bar while loading.
+///////////////////////////////////////////////////////////////////////////////
+void Window::setLoading(bool loading)
+{
+  ui_->centralwidget->setEnabled(!loading);
+
+  if(loading)
+    ui_->statusBar->showMessage("Loading...");
+  else
+    ui_->statusBar->clearMessage();
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Filters events.
 ///////////////////////////////////////////////////////////////////////////////
@@ -106,18 +174,27 @@ bool Window::eventFilter(QObject* object, QEvent* event)
 ///////////////////////////////////////////////////////////////////////////////
 void Window::selectCans(const QList<int>& can_ids)
 {
-  ui_->tableView->clearSelection();
-
   auto can_manager = Application::Instance()->canManager();
-  auto selection_model = ui_->tableView->selectionModel();
+  QItemSelection selection;
 
   auto it = can_ids.constBegin(),
        end = can_ids.constEnd();
 
-  for(; it != end; ++it)
-    selection_model->select(can_manager->index(can_manager->row(*it), 0),
-                            QItemSelectionModel::Select |
-                            QItemSelectionModel::Rows);
+  for(; it != end; ++it) {
+    if(!can_manager->exists(*it))
+      continue;
+
+    // Cans that are filtered out can't be selected.
+    auto can_index = can_filter_model_->mapFromSource(
+                       can_manager->index(can_manager->row(*it), 0));
+
+    if(can_index.isValid())
+      selection.select(can_index, can_index);
+  }
+
+  auto selection_model = ui_->tableView->selectionModel();
+  selection_model->select(selection, QItemSelectionModel::ClearAndSelect |
+                                     QItemSelectionModel::Rows);
 }
 
 
@@ -126,21 +203,38 @@ void Window::selectCans(const QList<int>& can_ids)
 ///////////////////////////////////////////////////////////////////////////////
 QList<int> Window::selectedCans() const
 {
-  auto can_manager = Application::Instance()->canManager();
-
   auto index_list = ui_->tableView->selectionModel()->selectedRows();
   QList<int> can_ids; {
     auto it = index_list.constBegin(),
          end = index_list.constEnd();
 
     for(; it != end; ++it)
-      can_ids.append(can_manager->data(*it).toInt());
+      can_ids.append(can_filter_model_->data(*it).toInt());
   }
 
   return can_ids;
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// Filters the cans by the expiry range in the filter box. Unchecked ends
+/// are left open.
+///////////////////////////////////////////////////////////////////////////////
+void Window::updateExpiryRange()
+{
+  int64_t first_day = std::numeric_limits<int64_t>::min();
+  int64_t last_day = std::numeric_limits<int64_t>::max();
+
+  if(ui_->fromCheckBox->isChecked())
+    first_day = ui_->fromDateEdit->date().toJulianDay();
+
+  if(ui_->toCheckBox->isChecked())
+    last_day = ui_->toDateEdit->date().toJulianDay();
+
+  can_filter_model_->setExpiryRange(first_day, last_day);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Submits the can data as a new can.
 ///////////////////////////////////////////////////////////////////////////////
@@ -149,13 +243,27 @@ void Window::on_addCanButton_clicked()
   QString good = ui_->addGoodComboBox->currentText();
   int64_t date = ui_->dateDateEdit->date().toJulianDay();
   int id_hint = ui_->idHintSpinBox->value();
+  int quantity = ui_->quantitySpinBox->value();
 
-  Application::Instance()->canManager()->add(good, date, &id_hint);
+  // The combo box is editable, but new goods go through the add good button.
+  if(!Application::Instance()->goodManager()->exists(good)) {
+    ui_->statusBar->showMessage(QString("No good named '%1'.").arg(good),
+                                5000);
+    return;
+  }
+
+  Application::Instance()->canManager()->add(good, date, &id_hint, quantity);
   ui_->idHintSpinBox->setValue(0);
+  ui_->quantitySpinBox->setValue(1);
 
   auto can_manager = Application::Instance()->canManager();
+  auto can_index = can_filter_model_->mapFromSource(
+                     can_manager->index(can_manager->lastRowAdded(), 0));
+
   ui_->tableView->setFocus(Qt::OtherFocusReason);
-  ui_->tableView->selectRow(can_manager->lastRowAdded());
+
+  if(can_index.isValid())
+    ui_->tableView->selectRow(can_index.row());
 }
 
 
@@ -181,6 +289,38 @@ void Window::on_addGoodToolButton_clicked()
     return;
 
   auto good_manager = Application::Instance()->goodManager();
+  auto similar_ids = good_manager->similar(good);
+
+  // Warn about near-duplicates, like "Peaches" for "peachs".
+  if(!similar_ids.isEmpty()) {
+    QStringList similar_goods; {
+      auto it = similar_ids.constBegin(),
+           end = similar_ids.constBegin() + qMin(similar_ids.size(), 5);
+
+      for(; it != end; ++it)
+        similar_goods.append(good_manager->good(*it));
+    }
+
+    QMessageBox message_box;
+    message_box.setText(QString(
+                        "'%1' looks like a good that already exists."
+                        ).arg(good));
+    message_box.setInformativeText(QString(
+                                   "Similar goods: %1\n\nAdd it anyway?"
+                                   ).arg(similar_goods.join(", ")));
+    message_box.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+    message_box.setDefaultButton(QMessageBox::No);
+    message_box.setIcon(QMessageBox::Warning);
+
+    // Pick the most alike existing good instead.
+    if(message_box.exec() != QMessageBox::Yes) {
+      good = good_manager->good(similar_ids.first());
+      ui_->addGoodComboBox->setCurrentIndex(
+        ui_->addGoodComboBox->findText(good));
+      return;
+    }
+  }
+
   good_manager->add(good);
 
   int index = ui_->addGoodComboBox->findText(good);
@@ -210,8 +350,13 @@ void Window::on_removeGoodButton_clicked()
   auto good_manager = Application::Instance()->goodManager();
   auto can_manager = Application::Instance()->canManager();
   QString good = ui_->removeGoodComboBox->currentText();
+
+  if(!good_manager->exists(good))
+    return;
+
   int good_id = good_manager->id(good);
-  int can_count = can_manager->goodRefCount(good_id);
+  int can_count = can_manager->totalQuantity(
+                    can_manager->goodCans(good_id).toList());
 
   QString text = QString("Are you sure you want to remove '%1'?").arg(good);
   QString informative_text = QString(
@@ -240,8 +385,9 @@ void Window::on_removeGoodButton_clicked()
 ///////////////////////////////////////////////////////////////////////////////
 void Window::on_actionEditGood_triggered()
 {
+  auto can_manager = Application::Instance()->canManager();
   auto can_ids = selectedCans();
-  int can_count = can_ids.count();
+  int can_count = can_manager->totalQuantity(can_ids);
 
   EditGoodDialog dialog(this);
   dialog.setText(QString(
@@ -249,16 +395,10 @@ void Window::on_actionEditGood_triggered()
                  ).arg(can_count).arg((can_count > 1) ? "s" : ""));
 
   if(dialog.exec() == QDialog::Accepted) {
-    auto can_manager = Application::Instance()->canManager();
-    QString good = dialog.good();
-    auto it = can_ids.constBegin(),
-         end = can_ids.constEnd();
+    if(!Application::Instance()->goodManager()->exists(dialog.good()))
+      return;
 
-    for(; it != end; ++it)
-      can_manager->editGood(*it, good);
-
-    // After sorting, the selections are invalid. Reselect.
-    can_manager->sort();
+    can_manager->editGoods(can_ids, dialog.good());
     selectCans(can_ids);
   }
 }
@@ -269,8 +409,9 @@ void Window::on_actionEditGood_triggered()
 ///////////////////////////////////////////////////////////////////////////////
 void Window::on_actionEditDate_triggered()
 {
+  auto can_manager = Application::Instance()->canManager();
   auto can_ids = selectedCans();
-  int can_count = can_ids.count();
+  int can_count = can_manager->totalQuantity(can_ids);
 
   EditDateDialog dialog(this);
   dialog.setText(QString(
@@ -278,16 +419,8 @@ void Window::on_actionEditDate_triggered()
                  ).arg(can_count).arg((can_count > 1) ? "s" : ""));
 
   if(dialog.exec() == QDialog::Accepted) {
-    auto can_manager = Application::Instance()->canManager();
     int64_t date = dialog.selectedDate().toJulianDay();
-    auto it = can_ids.constBegin(),
-         end = can_ids.constEnd();
-
-    for(; it != end; ++it)
-      can_manager->editDate(*it, date);
-
-    // After sorting, the selections are invalid. Reselect.
-    can_manager->sort();
+    can_manager->editDates(can_ids, date);
     selectCans(can_ids);
   }
 }
@@ -298,8 +431,9 @@ void Window::on_actionEditDate_triggered()
 ///////////////////////////////////////////////////////////////////////////////
 void Window::on_actionRemoveCan_triggered()
 {
+  auto can_manager = Application::Instance()->canManager();
   auto can_ids = selectedCans();
-  int can_count = can_ids.count();
+  int can_count = can_manager->totalQuantity(can_ids);
 
   QMessageBox message_box;
   message_box.setText(QString(
@@ -309,14 +443,90 @@ void Window::on_actionRemoveCan_triggered()
   message_box.setDefaultButton(QMessageBox::Cancel);
   message_box.setIcon(QMessageBox::Warning);
 
-  if(message_box.exec() == QMessageBox::Ok) {
-    auto can_manager = Application::Instance()->canManager();
-    auto it = can_ids.constBegin(),
-         end = can_ids.constEnd();
+  if(message_box.exec() == QMessageBox::Ok)
+    can_manager->removeMany(can_ids);
+}
 
-    for(; it != end; ++it)
-      can_manager->remove(*it);
+
+///////////////////////////////////////////////////////////////////////////////
+/// Takes one can from each of the selected cans. Lots shrink by one and
+/// stay selected; single cans are removed.
+///////////////////////////////////////////////////////////////////////////////
+void Window::on_actionTakeOne_triggered()
+{
+  auto can_ids = selectedCans();
+
+  Application::Instance()->canManager()->takeOne(can_ids);
+  selectCans(can_ids);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Splits one can off each of the selected lots, so it can be edited or
+/// removed on its own, and selects the new cans.
+///////////////////////////////////////////////////////////////////////////////
+void Window::on_actionSplitLot_triggered()
+{
+  auto can_manager = Application::Instance()->canManager();
+  auto can_ids = selectedCans();
+  QList<int> new_can_ids;
+
+  auto it = can_ids.constBegin(),
+       end = can_ids.constEnd();
+
+  for(; it != end; ++it) {
+    int new_can_id = can_manager->splitLot(*it);
+
+    if(new_can_id)
+      new_can_ids.append(new_can_id);
+  }
+
+  if(new_can_ids.isEmpty()) {
+    ui_->statusBar->showMessage("Only lots can be split.", 5000);
+    return;
   }
+
+  selectCans(new_can_ids);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Removes every can that expired before today, after asking.
+///////////////////////////////////////////////////////////////////////////////
+void Window::on_actionRemoveExpired_triggered()
+{
+  auto can_manager = Application::Instance()->canManager();
+  int64_t today = can_manager->today();
+  int can_count = can_manager->expiringOnOrBefore(today - 1);
+
+  if(!can_count) {
+    ui_->statusBar->showMessage("No cans expired before today.", 5000);
+    return;
+  }
+
+  QString text = QString(
+                 "Are you sure you want to remove the %1 can%2 that expired "
+                 "before today?"
+                 ).arg(can_count).arg((can_count > 1) ? "s" : "");
+
+  QMessageBox message_box;
+  message_box.setText(text);
+  message_box.setStandardButtons(QMessageBox::Ok | QMessageBox::Cancel);
+  message_box.setDefaultButton(QMessageBox::Cancel);
+  message_box.setIcon(QMessageBox::Warning);
+
+  if(message_box.exec() == QMessageBox::Ok)
+    can_manager->removeExpiredBefore(today);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Pops the diagnostics dialog.
+///////////////////////////////////////////////////////////////////////////////
+void Window::on_actionDiagnostics_triggered()
+{
+  DiagnosticsDialog dialog(this);
+  dialog.exec();
 }
 
 } // namespace jccu
@@ -13,6 +13,8 @@ class QMenu;
 namespace jccu
 {
 
+class CanFilterModel;
+
 ///////////////////////////////////////////////////////////////////////////////
 /// Main window.
 ///////////////////////////////////////////////////////////////////////////////
@@ -24,6 +26,8 @@ class Window : public QMainWindow
     Window();
     ~Window();
 
+    void setLoading(bool loading);
+
   private:
     Window(const Window&);
     Window& operator=(const Window&);
@@ -32,9 +36,11 @@ class Window : public QMainWindow
 
     void selectCans(const QList<int>& can_ids);
     QList<int> selectedCans() const;
+    void updateExpiryRange();
 
     Ui::Window* ui_;
     QMenu* can_context_menu_;
+    CanFilterModel* can_filter_model_;
 
   private slots:
     void on_addCanButton_clicked();
@@ -44,6 +50,10 @@ class Window : public QMainWindow
     void on_actionEditGood_triggered();
     void on_actionEditDate_triggered();
     void on_actionRemoveCan_triggered();
+    void on_actionTakeOne_triggered();
+    void on_actionSplitLot_triggered();
+    void on_actionRemoveExpired_triggered();
+    void on_actionDiagnostics_triggered();
 };
 
 } // namespace jccu
@@ -0,0 +1,298 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <limits>
+#include <QSet>
+#include <QSignalSpy>
+#include <QtTest>
+#include "can_filter_model.h"
+#include "can_manager.h"
+#include "date_manager.h"
+#include "good_manager.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Tests that CanFilterModel shows the cans its filters pass, and notifies
+/// only the rows that come and go.
+///////////////////////////////////////////////////////////////////////////////
+class CanFilterModelTest : public QObject
+{
+  Q_OBJECT
+
+  private slots:
+    void narrowsRunByRun();
+    void relayoutsManyRuns();
+    void followsSourceEdits();
+    void outlivedBySource();
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// A set of managers, as the application holds them.
+///////////////////////////////////////////////////////////////////////////////
+struct Managers
+{
+  Managers() : cans(&goods, &dates) {}
+
+  GoodManager goods;
+  DateManager dates;
+  CanManager cans;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the source rows filter shows, in order.
+///////////////////////////////////////////////////////////////////////////////
+static QVector<int> Shown(const CanFilterModel& filter)
+{
+  QVector<int> rows;
+
+  for(int i = 0; i < filter.rowCount(); ++i)
+    rows.append(filter.mapToSource(filter.index(i, 0)).row());
+
+  return rows;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the source rows of the cans expiring from first_day to last_day
+/// whose good matches query, checking every can.
+///////////////////////////////////////////////////////////////////////////////
+static QVector<int> Expected(const Managers& managers,
+                             const QString& query,
+                             int64_t first_day,
+                             int64_t last_day)
+{
+  QSet<int> good_ids;
+  QList<int> matches = managers.goods.search(query,
+                                             managers.goods.rowCount());
+
+  for(int i = 0; i < matches.size(); ++i)
+    good_ids.insert(matches.at(i));
+
+  QVector<int> rows;
+
+  for(int row = 0; row < managers.cans.rowCount(); ++row) {
+    int can_id = managers.cans.id(row);
+    int64_t date = managers.dates.date(managers.cans.dateIds().value(can_id));
+
+    if(date < first_day || date > last_day)
+      continue;
+
+    if(query.isEmpty() ||
+       good_ids.contains(managers.cans.goodIds().value(can_id)))
+      rows.append(row);
+  }
+
+  return rows;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns the number of runs of rows in before that aren't in after.
+///////////////////////////////////////////////////////////////////////////////
+static int RemovedRuns(const QVector<int>& before, const QVector<int>& after)
+{
+  int runs = 0;
+  bool removing = false;
+
+  for(int i = 0; i < before.size(); ++i) {
+    bool removed = !after.contains(before.at(i));
+    runs += (removed && !removing);
+    removing = removed;
+  }
+
+  return runs;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Narrowing the good filter removes each run of hidden rows on its own and
+/// never inserts any.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModelTest::narrowsRunByRun()
+{
+  Managers managers;
+  const char* goods[] = { "Corn", "Peas", "Tuna" };
+
+  // One can a day, so the rows are in the order added.
+  for(int i = 0; i < 30; ++i)
+    QVERIFY(managers.cans.add(goods[i % 3], 2461000 + i));
+
+  CanFilterModel filter(&managers.cans, &managers.goods, &managers.dates);
+  QSignalSpy inserted(&filter, SIGNAL(rowsInserted(QModelIndex,int,int)));
+  QSignalSpy removed(&filter, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+  QSignalSpy layout(&filter, SIGNAL(layoutChanged()));
+  QSignalSpy reset(&filter, SIGNAL(modelReset()));
+
+  QVector<int> before = Shown(filter);
+  QVector<int> after = Expected(managers, "Corn",
+                                std::numeric_limits<int64_t>::min(),
+                                std::numeric_limits<int64_t>::max());
+
+  QCOMPARE(before.size(), 30);
+  filter.setGoodFilter("Corn");
+
+  QCOMPARE(Shown(filter), after);
+  QCOMPARE(removed.count(), RemovedRuns(before, after));
+  QVERIFY(removed.count() > 1);
+  QCOMPARE(inserted.count(), 0);
+  QCOMPARE(layout.count(), 0);
+  QCOMPARE(reset.count(), 0);
+
+  // A narrower expiry range only drops rows at the ends.
+  removed.clear();
+  before = Shown(filter);
+  after = Expected(managers, "Corn", 2461005, 2461020);
+  filter.setExpiryRange(2461005, 2461020);
+
+  QCOMPARE(Shown(filter), after);
+  QCOMPARE(removed.count(), 2);
+  QCOMPARE(inserted.count(), 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// More than MaxRuns runs coming or going are a single layout change.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModelTest::relayoutsManyRuns()
+{
+  Managers managers;
+
+  for(int i = 0; i < 100; ++i)
+    QVERIFY(managers.cans.add((i % 2) ? "Corn" : "Peas", 2461000 + i));
+
+  CanFilterModel filter(&managers.cans, &managers.goods, &managers.dates);
+  QSignalSpy inserted(&filter, SIGNAL(rowsInserted(QModelIndex,int,int)));
+  QSignalSpy removed(&filter, SIGNAL(rowsRemoved(QModelIndex,int,int)));
+  QSignalSpy layout(&filter, SIGNAL(layoutChanged()));
+
+  filter.setGoodFilter("Corn");
+
+  QCOMPARE(Shown(filter),
+           Expected(managers, "Corn", std::numeric_limits<int64_t>::min(),
+                    std::numeric_limits<int64_t>::max()));
+  QCOMPARE(filter.rowCount(), 50);
+  QCOMPARE(layout.count(), 1);
+  QCOMPARE(removed.count(), 0);
+
+  filter.setGoodFilter(QString());
+
+  QCOMPARE(filter.rowCount(), 100);
+  QCOMPARE(layout.count(), 2);
+  QCOMPARE(inserted.count(), 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Random source edits and filter changes always leave the rows a full
+/// check of every can would show.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModelTest::followsSourceEdits()
+{
+  Managers managers;
+  CanFilterModel filter(&managers.cans, &managers.goods, &managers.dates);
+  const char* goods[] = { "Beans", "Corn", "Lentils", "Peas", "Tuna" };
+  const int64_t today = managers.cans.today();
+  QString query;
+  int64_t first_day = std::numeric_limits<int64_t>::min();
+  int64_t last_day = std::numeric_limits<int64_t>::max();
+  quint32 state = 2024;
+
+  auto Random = [&state](int bound) {
+    state = state * 1103515245 + 12345;
+    return int((state >> 8) % bound);
+  };
+
+  for(int i = 0; i < 600; ++i) {
+    const int rows = managers.cans.rowCount();
+    const int can_id = rows ? managers.cans.id(Random(rows)) : 0;
+    const QString good = goods[Random(5)];
+    const int64_t date = today - 20 + Random(60);
+
+    switch(rows < 10 ? 0 : Random(8)) {
+      case 0:
+      case 1:
+        managers.cans.add(good, date, nullptr, 1 + Random(3));
+        break;
+
+      case 2:
+        managers.cans.removeMany(QList<int>() << can_id);
+        break;
+
+      case 3:
+        managers.cans.editDate(can_id, managers.dates.exists(date)
+                                       ? date : today);
+        break;
+
+      case 4:
+        if(managers.goods.exists(good))
+          managers.cans.editGood(can_id, good);
+        break;
+
+      case 5:
+        managers.cans.editDates(QList<int>() << can_id
+                                << managers.cans.id(Random(rows)), date);
+        break;
+
+      case 6:
+        query = (Random(3) == 0) ? QString() : good.left(1 + Random(4));
+        filter.setGoodFilter(query);
+        break;
+
+      default:
+        first_day = today - 20 + Random(30);
+        last_day = first_day + Random(40);
+        filter.setExpiryRange(first_day, last_day);
+        break;
+    }
+
+    QCOMPARE(Shown(filter), Expected(managers, query, first_day, last_day));
+  }
+
+  // Bands narrow the expiry range relative to today.
+  filter.setExpiryRange(std::numeric_limits<int64_t>::min(),
+                        std::numeric_limits<int64_t>::max());
+  filter.setExpiryBand(CanFilterModel::MonthBand);
+  QCOMPARE(Shown(filter), Expected(managers, query, today + 1, today + 30));
+
+  filter.setExpiryBand(CanFilterModel::WeekBand);
+  QCOMPARE(Shown(filter), Expected(managers, query, today + 1, today + 7));
+
+  filter.setExpiryBand(CanFilterModel::ExpiredBand);
+  QCOMPARE(Shown(filter),
+           Expected(managers, query, std::numeric_limits<int64_t>::min(),
+                    today));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// A filter deleted before the managers stops following them.
+///////////////////////////////////////////////////////////////////////////////
+void CanFilterModelTest::outlivedBySource()
+{
+  Managers managers;
+  int can_id = 0;
+
+  QVERIFY(managers.cans.add("Corn", 2461000, &can_id));
+
+  CanFilterModel* filter = new CanFilterModel(&managers.cans,
+                                              &managers.goods,
+                                              &managers.dates);
+  filter->setGoodFilter("Corn");
+  delete filter;
+
+  QVERIFY(managers.cans.add("Peas", 2461010));
+  QVERIFY(managers.cans.editDate(can_id, 2461010));
+  QCOMPARE(managers.cans.removeMany(QList<int>() << can_id), 1);
+  managers.cans.clear();
+  managers.goods.clear();
+}
+
+} // namespace jccu
+
+QTEST_GUILESS_MAIN(jccu::CanFilterModelTest)
+#include "can_filter_model_test.moc"
@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QMap>
+#include <QtTest>
+#include "expiration_index.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Tests ExpirationIndex's per-day counts and prefix sums.
+///////////////////////////////////////////////////////////////////////////////
+class ExpirationIndexTest : public QObject
+{
+  Q_OBJECT
+
+  private slots:
+    void countsAppendedDays();
+    void insertsDayInTheMiddle();
+    void dropsEmptiedDays();
+    void spansOutlierDays();
+    void matchesMapModel();
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Days added in order are appended without a rebuild.
+///////////////////////////////////////////////////////////////////////////////
+void ExpirationIndexTest::countsAppendedDays()
+{
+  ExpirationIndex index;
+
+  for(int day = 100; day < 110; ++day)
+    index.add(day, day - 99);
+
+  QCOMPARE(index.total(), 55);
+  QCOMPARE(index.countOn(104), 5);
+  QCOMPARE(index.countOn(110), 0);
+  QCOMPARE(index.countOnOrBefore(99), 0);
+  QCOMPARE(index.countOnOrBefore(100), 1);
+  QCOMPARE(index.countOnOrBefore(104), 15);
+  QCOMPARE(index.countOnOrBefore(1000), 55);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// A day between two others rebuilds the tree; prefix counts stay right on
+/// both sides of it.
+///////////////////////////////////////////////////////////////////////////////
+void ExpirationIndexTest::insertsDayInTheMiddle()
+{
+  ExpirationIndex index;
+
+  index.add(10, 1);
+  index.add(30, 4);
+  index.add(20, 2);
+  index.add(5, 8);
+
+  QCOMPARE(index.countOnOrBefore(4), 0);
+  QCOMPARE(index.countOnOrBefore(5), 8);
+  QCOMPARE(index.countOnOrBefore(10), 9);
+  QCOMPARE(index.countOnOrBefore(19), 9);
+  QCOMPARE(index.countOnOrBefore(20), 11);
+  QCOMPARE(index.countOnOrBefore(29), 11);
+  QCOMPARE(index.countOnOrBefore(30), 15);
+  QCOMPARE(index.countOn(20), 2);
+  QCOMPARE(index.total(), 15);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Days whose count drops to zero stop counting and can come back.
+///////////////////////////////////////////////////////////////////////////////
+void ExpirationIndexTest::dropsEmptiedDays()
+{
+  ExpirationIndex index;
+
+  index.add(10, 3);
+  index.add(20, 2);
+  index.add(10, -3);
+
+  QCOMPARE(index.countOn(10), 0);
+  QCOMPARE(index.countOnOrBefore(15), 0);
+  QCOMPARE(index.total(), 2);
+
+  // A new day in the middle compacts the emptied one away.
+  index.add(15, 1);
+  index.add(10, 1);
+
+  QCOMPARE(index.countOnOrBefore(10), 1);
+  QCOMPARE(index.countOnOrBefore(15), 2);
+  QCOMPARE(index.countOnOrBefore(20), 4);
+
+  index.clear();
+
+  QCOMPARE(index.total(), 0);
+  QCOMPARE(index.countOnOrBefore(20), 0);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Days far apart cost one entry each, not the span between them.
+///////////////////////////////////////////////////////////////////////////////
+void ExpirationIndexTest::spansOutlierDays()
+{
+  ExpirationIndex index;
+  const int64_t far = Q_INT64_C(4000000000);
+
+  index.add(2460000);
+  index.add(far);
+  index.add(-far);
+  index.add(0);
+
+  QCOMPARE(index.total(), 4);
+  QCOMPARE(index.countOnOrBefore(-far - 1), 0);
+  QCOMPARE(index.countOnOrBefore(-1), 1);
+  QCOMPARE(index.countOnOrBefore(2460000), 3);
+  QCOMPARE(index.countOnOrBefore(far), 4);
+  QCOMPARE(index.countOn(far), 1);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Random adds and removals agree with a plain map of counts.
+///////////////////////////////////////////////////////////////////////////////
+void ExpirationIndexTest::matchesMapModel()
+{
+  ExpirationIndex index;
+  QMap<int64_t, int> counts;
+  quint32 state = 54321;
+
+  auto Random = [&state](int bound) {
+    state = state * 1103515245 + 12345;
+    return int((state >> 8) % bound);
+  };
+
+  for(int i = 0; i < 3000; ++i) {
+    int64_t day = 1000 + Random(120);
+    int count = counts.value(day);
+    int delta = (count && Random(3) == 0) ? -(1 + Random(count))
+                                          : 1 + Random(5);
+
+    index.add(day, delta);
+    counts[day] = count + delta;
+
+    int64_t probe = 995 + Random(130);
+    int before = 0;
+    int total = 0;
+
+    auto it = counts.constBegin(),
+         end = counts.constEnd();
+
+    for(; it != end; ++it) {
+      total += it.value();
+
+      if(it.key() <= probe)
+        before += it.value();
+    }
+
+    QCOMPARE(index.countOnOrBefore(probe), before);
+    QCOMPARE(index.countOn(probe), counts.value(probe));
+    QCOMPARE(index.total(), total);
+  }
+}
+
+} // namespace jccu
+
+QTEST_GUILESS_MAIN(jccu::ExpirationIndexTest)
+#include "expiration_index_test.moc"
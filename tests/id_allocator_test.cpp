@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QSet>
+#include <QtTest>
+#include "id_allocator.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Tests IdAllocator's gap tracking.
+///////////////////////////////////////////////////////////////////////////////
+class IdAllocatorTest : public QObject
+{
+  Q_OBJECT
+
+  private slots:
+    void reserveRejectsInvalidIds();
+    void reserveAboveTopLeavesGap();
+    void releaseMergesNeighbouringGaps();
+    void releaseAtTopLowersTop();
+    void matchesSetModel();
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Ids below 1 and ids already in use can't be reserved.
+///////////////////////////////////////////////////////////////////////////////
+void IdAllocatorTest::reserveRejectsInvalidIds()
+{
+  IdAllocator ids;
+
+  QVERIFY(!ids.reserve(0));
+  QVERIFY(!ids.reserve(-1));
+  QVERIFY(ids.reserve(1));
+  QVERIFY(!ids.reserve(1));
+  QVERIFY(!ids.release(2));
+  QCOMPARE(ids.next(), 2);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Reserving past the top frees everything in between for reuse.
+///////////////////////////////////////////////////////////////////////////////
+void IdAllocatorTest::reserveAboveTopLeavesGap()
+{
+  IdAllocator ids;
+
+  QVERIFY(ids.reserve(5));
+  QCOMPARE(ids.next(), 1);
+  QVERIFY(!ids.used(3));
+
+  QVERIFY(ids.reserve(3));
+  QCOMPARE(ids.next(), 1);
+  QVERIFY(ids.reserve(1));
+  QCOMPARE(ids.next(), 2);
+  QVERIFY(ids.reserve(2));
+  QCOMPARE(ids.next(), 4);
+  QVERIFY(ids.reserve(4));
+  QCOMPARE(ids.next(), 6);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// A freed id joins the gaps on either side, so the ids reserved back come
+/// out of one range in order.
+///////////////////////////////////////////////////////////////////////////////
+void IdAllocatorTest::releaseMergesNeighbouringGaps()
+{
+  IdAllocator ids;
+
+  for(int id = 1; id <= 10; ++id)
+    QVERIFY(ids.reserve(id));
+
+  QVERIFY(ids.release(4));
+  QVERIFY(ids.release(6));
+  QVERIFY(ids.release(5));
+  QVERIFY(!ids.release(5));
+
+  for(int id = 4; id <= 6; ++id) {
+    QVERIFY(!ids.used(id));
+    QCOMPARE(ids.next(), id);
+    QVERIFY(ids.reserve(id));
+  }
+
+  QCOMPARE(ids.next(), 11);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Freeing the top id also swallows the gap right below it.
+///////////////////////////////////////////////////////////////////////////////
+void IdAllocatorTest::releaseAtTopLowersTop()
+{
+  IdAllocator ids;
+
+  for(int id = 1; id <= 5; ++id)
+    QVERIFY(ids.reserve(id));
+
+  QVERIFY(ids.release(3));
+  QVERIFY(ids.release(4));
+  QVERIFY(ids.release(5));
+
+  QVERIFY(ids.used(2));
+  QVERIFY(!ids.used(3));
+  QCOMPARE(ids.next(), 3);
+
+  // With the top back at 2, reserving 7 leaves 3 to 6 free.
+  QVERIFY(ids.reserve(7));
+
+  for(int id = 3; id <= 6; ++id)
+    QVERIFY(!ids.used(id));
+
+  QCOMPARE(ids.next(), 3);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Random reserves and releases agree with a plain set of used ids.
+///////////////////////////////////////////////////////////////////////////////
+void IdAllocatorTest::matchesSetModel()
+{
+  IdAllocator ids;
+  QSet<int> used;
+  quint32 state = 12345;
+
+  auto Random = [&state](int bound) {
+    state = state * 1103515245 + 12345;
+    return int((state >> 8) % bound);
+  };
+
+  for(int i = 0; i < 5000; ++i) {
+    int id = 1 + Random(200);
+
+    if(Random(2)) {
+      QCOMPARE(ids.reserve(id), !used.contains(id));
+      used.insert(id);
+    }
+    else {
+      QCOMPARE(ids.release(id), used.contains(id));
+      used.remove(id);
+    }
+
+    int next = 1;
+
+    while(used.contains(next))
+      ++next;
+
+    QCOMPARE(ids.next(), next);
+  }
+
+  for(int id = 0; id <= 210; ++id)
+    QCOMPARE(ids.used(id), used.contains(id));
+}
+
+} // namespace jccu
+
+QTEST_GUILESS_MAIN(jccu::IdAllocatorTest)
+#include "id_allocator_test.moc"
@@ -0,0 +1,303 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "can_manager.h"
+#include "date_manager.h"
+#include "good_manager.h"
+#include "inventory.h"
+#include "journal_manager.h"
+#include "snapshot_manager.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Tests that replaying the journal over the snapshot it follows gives back
+/// what the managers held, including across a rotation.
+///////////////////////////////////////////////////////////////////////////////
+class JournalManagerTest : public QObject
+{
+  Q_OBJECT
+
+  private slots:
+    void init();
+    void cleanup();
+
+    void replaysEdits();
+    void stopsAtTornRecord();
+    void replaysAcrossRotation();
+    void skipsOtherGenerations();
+
+  private:
+    QTemporaryDir* dir_;
+    QString snapshot_file_name_;
+    QString journal_file_name_;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// A set of managers, as the application and the load task hold them.
+///////////////////////////////////////////////////////////////////////////////
+struct Managers
+{
+  Managers() : cans(&goods, &dates) {}
+
+  GoodManager goods;
+  DateManager dates;
+  CanManager cans;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns true if a and b hold the same goods, dates and cans, ids included.
+///////////////////////////////////////////////////////////////////////////////
+static bool Same(const Managers& a, const Managers& b)
+{
+  Inventory inventory_a(&a.goods, &a.dates, &a.cans);
+  Inventory inventory_b(&b.goods, &b.dates, &b.cans);
+
+  return inventory_a.goods() == inventory_b.goods() &&
+         inventory_a.dates() == inventory_b.dates() &&
+         inventory_a.canGoodIds() == inventory_b.canGoodIds() &&
+         inventory_a.canDateIds() == inventory_b.canDateIds() &&
+         inventory_a.canQuantities() == inventory_b.canQuantities();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Gives each test its own directory for the snapshot and journals.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManagerTest::init()
+{
+  dir_ = new QTemporaryDir;
+  QVERIFY(dir_->isValid());
+
+  snapshot_file_name_ = dir_->path() + "/can_data.snap";
+  journal_file_name_ = dir_->path() + "/can_data.jrn";
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Removes the test's directory.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManagerTest::cleanup()
+{
+  delete dir_;
+  dir_ = nullptr;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Every kind of edit replays to the same ids, goods, dates and quantities.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManagerTest::replaysEdits()
+{
+  Managers live;
+  SnapshotManager snapshot(snapshot_file_name_,
+                           &live.goods, &live.dates, &live.cans);
+  JournalManager journal(journal_file_name_,
+                         &live.goods, &live.dates, &live.cans);
+  int ids[6] = {};
+
+  QVERIFY(live.cans.add("Beans", 2461000, &ids[0]));
+  QVERIFY(live.cans.add("Corn", 2461010, &ids[1]));
+  QVERIFY(journal.open(1));
+  QVERIFY(snapshot.write(1, journal.size()));
+
+  QVERIFY(live.cans.add("Peas", 2461020, &ids[2]));
+  QVERIFY(live.cans.add("Soup", 2461005, &ids[3], 6));
+  QVERIFY(live.cans.add("Tuna", 2461030, &ids[4]));
+  QVERIFY(live.cans.add("Beans", 2461040, &ids[5]));
+  QVERIFY(live.goods.add("Lentils"));
+  QVERIFY(live.goods.add("Chili"));
+  QVERIFY(live.dates.add(2461025));
+  QVERIFY(live.cans.editGood(ids[1], "Lentils"));
+  QVERIFY(live.cans.editDate(ids[2], 2461025));
+  QCOMPARE(live.cans.editGoods(QList<int>() << ids[4] << ids[5], "Chili"), 2);
+  QCOMPARE(live.cans.editDates(QList<int>() << ids[1] << ids[4], 2461050), 2);
+  QVERIFY(live.cans.setQuantity(ids[3], 4));
+  QCOMPARE(live.cans.removeMany(QList<int>() << ids[5]), 1);
+  QCOMPARE(live.cans.removeExpiredBefore(2461006), 2);
+
+  Managers restored;
+  SnapshotManager restored_snapshot(snapshot_file_name_, &restored.goods,
+                                    &restored.dates, &restored.cans);
+  JournalManager restored_journal(journal_file_name_, &restored.goods,
+                                  &restored.dates, &restored.cans);
+  quint64 generation = 0;
+  qint64 offset = 0;
+  qint64 replayed_size = 0;
+
+  QVERIFY(restored_snapshot.read(&generation, &offset));
+  QCOMPARE(generation, quint64(1));
+  QVERIFY(restored_journal.replay(generation, offset, &replayed_size) > 0);
+  QCOMPARE(replayed_size, journal.size());
+  QVERIFY(Same(live, restored));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Replay stops before a torn record, and resuming the journal there drops
+/// it and records the next edits after the last good one.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManagerTest::stopsAtTornRecord()
+{
+  Managers live;
+  SnapshotManager snapshot(snapshot_file_name_,
+                           &live.goods, &live.dates, &live.cans);
+  JournalManager journal(journal_file_name_,
+                         &live.goods, &live.dates, &live.cans);
+
+  QVERIFY(journal.open(1));
+  QVERIFY(snapshot.write(1, journal.size()));
+  QVERIFY(live.cans.add("Beans", 2461000));
+  QVERIFY(live.cans.add("Corn", 2461010));
+
+  qint64 size = journal.size();
+  journal.close();
+
+  // A record that claims more payload than made it to the disk.
+  QFile file(journal_file_name_);
+  QVERIFY(file.open(QFile::Append));
+  QVERIFY(file.write(QByteArray("\x20\x00\x00\x00\x12\x34\x05\x01", 8)) == 8);
+  file.close();
+
+  Managers restored;
+  SnapshotManager restored_snapshot(snapshot_file_name_, &restored.goods,
+                                    &restored.dates, &restored.cans);
+  JournalManager restored_journal(journal_file_name_, &restored.goods,
+                                  &restored.dates, &restored.cans);
+  quint64 generation = 0;
+  qint64 offset = 0;
+  qint64 replayed_size = 0;
+
+  QVERIFY(restored_snapshot.read(&generation, &offset));
+  QVERIFY(restored_journal.replay(generation, offset, &replayed_size) > 0);
+  QCOMPARE(replayed_size, size);
+  QVERIFY(Same(live, restored));
+
+  QVERIFY(restored_journal.resume(replayed_size));
+  QCOMPARE(restored_journal.size(), size);
+  QVERIFY(restored.cans.add("Peas", 2461020));
+  restored_journal.close();
+
+  Managers again;
+  SnapshotManager again_snapshot(snapshot_file_name_,
+                                 &again.goods, &again.dates, &again.cans);
+  JournalManager again_journal(journal_file_name_,
+                               &again.goods, &again.dates, &again.cans);
+
+  QVERIFY(again_snapshot.read(&generation, &offset));
+  QVERIFY(again_journal.replay(generation, offset) > 0);
+  QVERIFY(Same(restored, again));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Until the snapshot of the new generation lands, the old snapshot replays
+/// through the .old journal and then the new one; after, the new snapshot
+/// replays through the new journal alone.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManagerTest::replaysAcrossRotation()
+{
+  Managers live;
+  SnapshotManager snapshot(snapshot_file_name_,
+                           &live.goods, &live.dates, &live.cans);
+  JournalManager journal(journal_file_name_,
+                         &live.goods, &live.dates, &live.cans);
+  int id = 0;
+
+  QVERIFY(journal.open(1));
+  QVERIFY(snapshot.write(1, journal.size()));
+  QVERIFY(live.cans.add("Beans", 2461000, &id));
+  QVERIFY(live.cans.add("Corn", 2461010));
+
+  QVERIFY(journal.rotate(2));
+  QVERIFY(QFile::exists(journal_file_name_ + ".old"));
+  QCOMPARE(journal.generation(), quint64(2));
+
+  qint64 offset = journal.size();
+
+  QVERIFY(live.goods.add("Peas"));
+  QVERIFY(live.cans.editGood(id, "Peas"));
+  QVERIFY(live.cans.add("Soup", 2461020, nullptr, 3));
+
+  quint64 generation = 0;
+  qint64 snapshot_offset = 0;
+
+  {
+    Managers restored;
+    SnapshotManager restored_snapshot(snapshot_file_name_, &restored.goods,
+                                      &restored.dates, &restored.cans);
+    JournalManager restored_journal(journal_file_name_, &restored.goods,
+                                    &restored.dates, &restored.cans);
+    qint64 replayed_size = 0;
+
+    QVERIFY(restored_snapshot.read(&generation, &snapshot_offset));
+    QCOMPARE(generation, quint64(1));
+    QVERIFY(restored_journal.replay(generation, snapshot_offset,
+                                    &replayed_size) > 0);
+    QCOMPARE(replayed_size, journal.size());
+    QVERIFY(Same(live, restored));
+  }
+
+  // The snapshot of generation 2 is the state at the rotation, so put the
+  // post-rotation edits on top of it after writing it.
+  Managers at_rotation;
+  SnapshotManager old_snapshot(snapshot_file_name_, &at_rotation.goods,
+                               &at_rotation.dates, &at_rotation.cans);
+  JournalManager old_journal(journal_file_name_ + ".old", &at_rotation.goods,
+                             &at_rotation.dates, &at_rotation.cans);
+
+  QVERIFY(old_snapshot.read(&generation, &snapshot_offset));
+  QVERIFY(old_journal.replay(generation, snapshot_offset) > 0);
+  QVERIFY(old_snapshot.write(2, offset));
+  QVERIFY(live.cans.add("Tuna", 2461030));
+
+  Managers restored;
+  SnapshotManager restored_snapshot(snapshot_file_name_, &restored.goods,
+                                    &restored.dates, &restored.cans);
+  JournalManager restored_journal(journal_file_name_, &restored.goods,
+                                  &restored.dates, &restored.cans);
+
+  QVERIFY(restored_snapshot.read(&generation, &snapshot_offset));
+  QCOMPARE(generation, quint64(2));
+  QVERIFY(restored_journal.replay(generation, snapshot_offset) > 0);
+  QVERIFY(Same(live, restored));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// A journal that doesn't follow the snapshot's generation isn't replayed.
+///////////////////////////////////////////////////////////////////////////////
+void JournalManagerTest::skipsOtherGenerations()
+{
+  Managers live;
+  JournalManager journal(journal_file_name_,
+                         &live.goods, &live.dates, &live.cans);
+
+  QVERIFY(journal.open(3));
+  QVERIFY(live.cans.add("Beans", 2461000));
+  QVERIFY(journal.rotate(4));
+  QVERIFY(live.cans.add("Corn", 2461010));
+  journal.close();
+
+  Managers restored;
+  JournalManager restored_journal(journal_file_name_, &restored.goods,
+                                  &restored.dates, &restored.cans);
+  qint64 replayed_size = -1;
+
+  QCOMPARE(restored_journal.replay(2, 0, &replayed_size), 0);
+  QCOMPARE(replayed_size, qint64(0));
+  QCOMPARE(restored.cans.rowCount(), 0);
+  QCOMPARE(restored.goods.rowCount(), 0);
+  QVERIFY(!restored_journal.resume(replayed_size));
+}
+
+} // namespace jccu
+
+QTEST_GUILESS_MAIN(jccu::JournalManagerTest)
+#include "journal_manager_test.moc"
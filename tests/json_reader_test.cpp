@@ -0,0 +1,223 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <QBuffer>
+#include <QtTest>
+#include "json_reader.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Tests JsonReader's tokens, especially those split across the 64 KiB chunks
+/// it reads the device in.
+///////////////////////////////////////////////////////////////////////////////
+class JsonReaderTest : public QObject
+{
+  Q_OBJECT
+
+  private slots:
+    void readsValuesAcrossChunks();
+    void readsNamesAcrossChunks();
+    void skipsNestedValues();
+    void rejectsMalformedInput();
+    void rejectsTruncatedInput();
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Size of the chunks JsonReader reads; must match json_reader.cpp.
+///////////////////////////////////////////////////////////////////////////////
+static const int ChunkSize = 64 * 1024;
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns text padded with leading whitespace so that its byte at split
+/// lands on the first byte of the second chunk.
+///////////////////////////////////////////////////////////////////////////////
+static QByteArray Straddle(const QByteArray& prefix, const QByteArray& text,
+                           int split)
+{
+  return prefix + QByteArray(ChunkSize - prefix.size() - split, ' ') + text;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Every scalar comes out whole wherever the chunk boundary falls in it.
+///////////////////////////////////////////////////////////////////////////////
+void JsonReaderTest::readsValuesAcrossChunks()
+{
+  struct Value {
+    const char* json;
+    JsonReader::Token token;
+    const char* text;
+  };
+
+  const Value values[] = {
+    { "\"plain\"", JsonReader::String, "plain" },
+    { "\"a\\\"b\\\\c\\/d\\ne\\tf\"", JsonReader::String, "a\"b\\c/d\ne\tf" },
+    { "\"caf\\u00e9\"", JsonReader::String, "caf\xc3\xa9" },
+    { "\"\\ud83d\\ude00!\"", JsonReader::String, "\xf0\x9f\x98\x80!" },
+    { "-1234567890123", JsonReader::Number, "-1234567890123" },
+    { "6.02e+23", JsonReader::Number, "6.02e+23" },
+    { "true", JsonReader::Bool, "true" },
+    { "false", JsonReader::Bool, "false" },
+    { "null", JsonReader::Null, "null" }
+  };
+
+  for(const Value& value : values) {
+    QByteArray json(value.json);
+
+    for(int split = 0; split <= json.size(); ++split) {
+      QBuffer buffer;
+      buffer.setData(Straddle("[", json, split) + "]");
+      QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+      JsonReader reader(&buffer);
+
+      QCOMPARE(reader.next(), JsonReader::BeginArray);
+      QCOMPARE(reader.next(), value.token);
+      QCOMPARE(reader.text(), QByteArray(value.text));
+      QCOMPARE(reader.next(), JsonReader::EndArray);
+      QCOMPARE(reader.next(), JsonReader::EndDocument);
+      QVERIFY(!reader.hasError());
+    }
+  }
+
+  QBuffer buffer;
+  buffer.setData(Straddle("[", "true", 2) + "]");
+  QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+  JsonReader reader(&buffer);
+  reader.next();
+  reader.next();
+
+  QVERIFY(reader.toBool());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// A name and its colon come out whole wherever the boundary falls, including
+/// in the whitespace before the colon.
+///////////////////////////////////////////////////////////////////////////////
+void JsonReaderTest::readsNamesAcrossChunks()
+{
+  QByteArray json("\"good_id\" \t: 42");
+
+  for(int split = 0; split <= json.size(); ++split) {
+    QBuffer buffer;
+    buffer.setData(Straddle("{", json, split) + "}");
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    JsonReader reader(&buffer);
+    bool ok = false;
+
+    QCOMPARE(reader.next(), JsonReader::BeginObject);
+    QCOMPARE(reader.next(), JsonReader::Name);
+    QCOMPARE(reader.string(), QString("good_id"));
+    QCOMPARE(reader.next(), JsonReader::Number);
+    QCOMPARE(reader.toInt(&ok), 42);
+    QVERIFY(ok);
+    QCOMPARE(reader.next(), JsonReader::EndObject);
+    QCOMPARE(reader.next(), JsonReader::EndDocument);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// skipValue() steps over a whole nested value, brackets in strings included,
+/// and leaves the reader on the value that follows it.
+///////////////////////////////////////////////////////////////////////////////
+void JsonReaderTest::skipsNestedValues()
+{
+  QByteArray json("{\"a\":[1,{\"b\":\"}]\"}],\"c\":{}}");
+
+  for(int split = 0; split <= json.size(); split += 3) {
+    QBuffer buffer;
+    buffer.setData(Straddle("{\"skip\":", json, split) + ",\"keep\":7}");
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    JsonReader reader(&buffer);
+
+    QCOMPARE(reader.next(), JsonReader::BeginObject);
+    QCOMPARE(reader.next(), JsonReader::Name);
+    QVERIFY(reader.skipValue());
+    QCOMPARE(reader.token(), JsonReader::EndObject);
+    QCOMPARE(reader.next(), JsonReader::Name);
+    QCOMPARE(reader.string(), QString("keep"));
+    QCOMPARE(reader.next(), JsonReader::Number);
+    QCOMPARE(reader.toInt(), 7);
+    QCOMPARE(reader.next(), JsonReader::EndObject);
+    QCOMPARE(reader.next(), JsonReader::EndDocument);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Malformed documents end in Invalid, and the reader stays there.
+///////////////////////////////////////////////////////////////////////////////
+void JsonReaderTest::rejectsMalformedInput()
+{
+  const char* documents[] = {
+    "",
+    "[1,]",
+    "{\"a\":1,}",
+    "{\"a\" 1}",
+    "{1:2}",
+    "[1 2]",
+    "[1]]",
+    "1 2",
+    "[tru]",
+    "[-]",
+    "[\"tab\there\"]",
+    "[\"\\x\"]",
+    "[\"\\u12g4\"]",
+    "[\"\\ud800\\u0041\"]"
+  };
+
+  for(const char* document : documents) {
+    QBuffer buffer;
+    buffer.setData(document);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    JsonReader reader(&buffer);
+    JsonReader::Token token;
+
+    do {
+      token = reader.next();
+    } while(token != JsonReader::Invalid && token != JsonReader::EndDocument);
+
+    QCOMPARE(token, JsonReader::Invalid);
+    QVERIFY(reader.hasError());
+    QCOMPARE(reader.next(), JsonReader::Invalid);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// A document cut short anywhere, on either side of a chunk boundary, is an
+/// error rather than a shorter document.
+///////////////////////////////////////////////////////////////////////////////
+void JsonReaderTest::rejectsTruncatedInput()
+{
+  QByteArray document = Straddle("{\"cans\":[", "{\"id\":1,\"name\":\"\\u00e9\","
+                                 "\"fresh\":true,\"note\":null}", 12) + "]}";
+
+  for(int size = ChunkSize - 40; size < document.size(); ++size) {
+    QBuffer buffer;
+    buffer.setData(document.left(size));
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    JsonReader reader(&buffer);
+
+    while(reader.next() != JsonReader::Invalid)
+      QVERIFY(reader.token() != JsonReader::EndDocument);
+
+    QVERIFY(reader.hasError());
+  }
+}
+
+} // namespace jccu
+
+QTEST_GUILESS_MAIN(jccu::JsonReaderTest)
+#include "json_reader_test.moc"
@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QDate>
+#include <QSaveFile>
+#include <QString>
+#include <QStringList>
+#include "can_manager.h"
+#include "inventory.h"
+#include "inventory_generator.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// Prints how to use the program and returns the exit code for misuse.
+///////////////////////////////////////////////////////////////////////////////
+static int Usage()
+{
+  fprintf(stderr,
+    "Usage: jccu-generate [options] file\n"
+    "  --cans N            number of cans (default 100000)\n"
+    "  --goods N           number of goods (default one per hundred cans)\n"
+    "  --skew S            good popularity skew, 0 for even (default 1)\n"
+    "  --start YYYY-MM-DD  earliest expiration date (default 2024-01-01)\n"
+    "  --days N            days the dates cover (default 1095)\n"
+    "  --clusters N        days dates cluster around, 0 for even "
+                           "(default 24)\n"
+    "  --lots P            percent of cans that are lots of 2 to 24 "
+                           "(default 0)\n"
+    "  --seed N            random seed (default 1)\n"
+    "  --version N         file format, 1 to 3 (default 3)\n"
+    "  --dangling-goods    refer some cans to goods that don't exist\n"
+    "  --duplicate-dates   repeat some dates under a second id\n");
+
+  return 2;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Program entry point.
+/// Writes a generated can_data.json style file. The same options always
+/// write the same file.
+///////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv)
+{
+  QCoreApplication app(argc, argv);
+  QStringList arguments = app.arguments();
+
+  quint32 seed = 1;
+  int can_count = 100000;
+  int good_count = 0;
+  double good_skew = 1.0;
+  int64_t first_day = jccu::InventoryGenerator::DefaultFirstDay;
+  int day_spread = 3 * 365;
+  int date_clusters = 24;
+  int lot_percent = 0;
+  int version = 3;
+  int damage = jccu::InventoryGenerator::NoDamage;
+  QString file_name;
+
+  for(int i = 1; i < arguments.size(); ++i) {
+    const QString& argument = arguments.at(i);
+
+    if(argument == "--dangling-goods") {
+      damage |= jccu::InventoryGenerator::DanglingGoods;
+      continue;
+    }
+
+    if(argument == "--duplicate-dates") {
+      damage |= jccu::InventoryGenerator::DuplicateDates;
+      continue;
+    }
+
+    if(!argument.startsWith("--")) {
+      if(!file_name.isEmpty())
+        return Usage();
+
+      file_name = argument;
+      continue;
+    }
+
+    if(i + 1 >= arguments.size())
+      return Usage();
+
+    const QString& value = arguments.at(++i);
+    bool ok = true;
+
+    if(argument == "--cans")
+      can_count = value.toInt(&ok);
+    else if(argument == "--goods")
+      good_count = value.toInt(&ok);
+    else if(argument == "--skew")
+      good_skew = value.toDouble(&ok);
+    else if(argument == "--days")
+      day_spread = value.toInt(&ok);
+    else if(argument == "--clusters")
+      date_clusters = value.toInt(&ok);
+    else if(argument == "--lots")
+      lot_percent = value.toInt(&ok);
+    else if(argument == "--seed")
+      seed = value.toUInt(&ok);
+    else if(argument == "--version")
+      version = value.toInt(&ok);
+    else if(argument == "--start") {
+      QDate start = QDate::fromString(value, Qt::ISODate);
+      ok = start.isValid();
+      first_day = start.toJulianDay();
+    }
+    else
+      ok = false;
+
+    if(!ok)
+      return Usage();
+  }
+
+  if(file_name.isEmpty() || version < 1 || version > 3)
+    return Usage();
+
+  jccu::InventoryGenerator generator(seed);
+  generator.setCanCount(can_count);
+  generator.setGoodCount(good_count);
+  generator.setGoodSkew(good_skew);
+  generator.setFirstDay(first_day);
+  generator.setDaySpread(day_spread);
+  generator.setDateClusters(date_clusters);
+  generator.setLotPercent(lot_percent);
+
+  jccu::GoodManager goods;
+  jccu::DateManager dates;
+  jccu::CanManager cans(&goods, &dates);
+
+  generator.generate(&goods, &dates, &cans);
+
+  QByteArray data = generator.json(jccu::Inventory(&goods, &dates, &cans),
+                                   version,
+                                   damage);
+
+  QSaveFile file(file_name);
+
+  if(!file.open(QSaveFile::WriteOnly) || file.write(data) != data.size() ||
+     !file.commit()) {
+    fprintf(stderr, "Can't write %s.\n", qPrintable(file_name));
+    return 1;
+  }
+
+  printf("%d cans, %d goods and %d dates written to %s.\n",
+         cans.rowCount(),
+         goods.rowCount(),
+         dates.rowCount(),
+         qPrintable(file_name));
+
+  return 0;
+}
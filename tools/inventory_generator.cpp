@@ -0,0 +1,425 @@
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include "inventory_generator.h"
+
+#include <math.h>
+#include <algorithm>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include "can_manager.h"
+#include "inventory.h"
+#include "json_writer.h"
+
+namespace jccu
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// Constructor.
+/// Defaults to 100k single cans with dates clustered over three years,
+/// starting on DefaultFirstDay. The start is fixed rather than taken from today, so a
+/// seed gives the same file whenever it's run.
+///////////////////////////////////////////////////////////////////////////////
+InventoryGenerator::InventoryGenerator(quint32 seed)
+  : state_(seed),
+    can_count_(100000),
+    good_count_(0),
+    good_skew_(1.0),
+    first_day_(DefaultFirstDay),
+    day_spread_(3 * 365),
+    date_clusters_(24),
+    lot_percent_(0)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Destructor.
+///////////////////////////////////////////////////////////////////////////////
+InventoryGenerator::~InventoryGenerator()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets the number of cans to generate.
+///////////////////////////////////////////////////////////////////////////////
+void InventoryGenerator::setCanCount(int can_count)
+{
+  can_count_ = qMax(0, can_count);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets the number of goods to generate. Zero means one per hundred cans.
+///////////////////////////////////////////////////////////////////////////////
+void InventoryGenerator::setGoodCount(int good_count)
+{
+  good_count_ = qMax(0, good_count);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets how much more popular the most popular goods are. The nth most
+/// popular good is picked in proportion to 1 / n^good_skew, so zero picks
+/// every good evenly.
+///////////////////////////////////////////////////////////////////////////////
+void InventoryGenerator::setGoodSkew(double good_skew)
+{
+  good_skew_ = qMax(0.0, good_skew);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets the earliest expiration date (Julian day).
+///////////////////////////////////////////////////////////////////////////////
+void InventoryGenerator::setFirstDay(int64_t first_day)
+{
+  first_day_ = first_day;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets the number of days expiration dates are spread over.
+///////////////////////////////////////////////////////////////////////////////
+void InventoryGenerator::setDaySpread(int day_spread)
+{
+  day_spread_ = qMax(1, day_spread);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets the number of days expiration dates cluster around. Zero spreads
+/// them evenly.
+///////////////////////////////////////////////////////////////////////////////
+void InventoryGenerator::setDateClusters(int date_clusters)
+{
+  date_clusters_ = qMax(0, date_clusters);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Sets the percentage of cans that are lots of 2 to 24 rather than single
+/// cans. Zero draws no extra random numbers, so a seed gives the same
+/// inventory as it did before lots.
+///////////////////////////////////////////////////////////////////////////////
+void InventoryGenerator::setLotPercent(int lot_percent)
+{
+  lot_percent_ = qBound(0, lot_percent, 100);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Replaces the managers' contents with a generated inventory, using a
+/// single bulk load.
+///////////////////////////////////////////////////////////////////////////////
+void InventoryGenerator::generate(GoodManager* good_manager,
+                                  DateManager* date_manager,
+                                  CanManager* can_manager)
+{
+  const int good_count = good_count_ ? good_count_
+                                     : qMax(1, can_count_ / 100);
+
+  // Popularity is handed out in a shuffled order, so the most popular goods
+  // aren't also the first alphabetically.
+  QVector<int> good_ids(good_count);
+  QVector<double> weights(good_count); // Cumulative, by popularity.
+  double total_weight = 0;
+
+  for(int i = 0; i < good_count; ++i) {
+    good_ids[i] = i + 1;
+    total_weight += 1.0 / pow(i + 1.0, good_skew_);
+    weights[i] = total_weight;
+  }
+
+  for(int i = good_count - 1; i > 0; --i)
+    qSwap(good_ids[i], good_ids[random(i + 1)]);
+
+  // Each cluster covers about a quarter of the gap between clusters.
+  QVector<int> centers(date_clusters_);
+  const int width = qMax(1, day_spread_ / qMax(1, date_clusters_ * 4));
+
+  for(int i = 0; i < date_clusters_; ++i)
+    centers[i] = random(day_spread_);
+
+  good_manager->beginBulkLoad();
+  date_manager->beginBulkLoad();
+  can_manager->beginBulkLoad();
+
+  for(int i = 0; i < good_count; ++i)
+    good_manager->insert(i + 1, GoodName(i));
+
+  QHash<int, int> date_ids; // <Day, DateId>
+  const int Resolution = 1 << 30;
+
+  for(int can_id = 1; can_id <= can_count_; ++can_id) {
+    double pick = total_weight * random(Resolution) / Resolution;
+    int rank = std::upper_bound(weights.constBegin(), weights.constEnd(),
+                                pick) - weights.constBegin();
+    rank = qMin(rank, good_count - 1);
+
+    int day;
+
+    if(date_clusters_) {
+      day = centers.at(random(date_clusters_));
+      day += random(width);
+      day -= random(width);
+      day = qBound(0, day, day_spread_ - 1);
+    }
+    else {
+      day = random(day_spread_);
+    }
+
+    int date_id = date_ids.value(day);
+
+    if(!date_id) {
+      date_id = date_ids.size() + 1;
+      date_ids.insert(day, date_id);
+      date_manager->insert(date_id, first_day_ + day);
+    }
+
+    int quantity = 1;
+
+    if(lot_percent_ && random(100) < lot_percent_)
+      quantity = 2 + random(23);
+
+    can_manager->insert(can_id, good_ids.at(rank), date_id, quantity);
+  }
+
+  good_manager->endBulkLoad();
+  date_manager->endBulkLoad();
+  can_manager->endBulkLoad();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns inventory as a json file of the given version (1 to 3), with
+/// the given damage (a combination of Damage flags) done to it. Only v3
+/// has lots; older versions write each lot as a single can.
+/// Everything is written in id order, so the output only depends on the
+/// inventory, the seed and what was generated before.
+///////////////////////////////////////////////////////////////////////////////
+QByteArray InventoryGenerator::json(const Inventory& inventory,
+                                    int version,
+                                    int damage)
+{
+  QHash<int, int64_t> dates = inventory.dates();
+  QHash<int, int> can_goods = inventory.canGoodIds();
+  QHash<int, int> can_dates = inventory.canDateIds();
+  const QHash<int, int>& can_quantities = inventory.canQuantities();
+
+  QList<int> good_ids = inventory.goods().keys();
+  QList<int> date_ids = dates.keys();
+  QList<int> can_ids = can_goods.keys();
+
+  std::sort(good_ids.begin(), good_ids.end());
+  std::sort(date_ids.begin(), date_ids.end());
+  std::sort(can_ids.begin(), can_ids.end());
+
+  const int damage_count = qMax(1, can_ids.size() / 100);
+
+  if((damage & DanglingGoods) && !can_ids.isEmpty()) {
+    const int top = good_ids.isEmpty() ? 0 : good_ids.last();
+
+    for(int i = 0; i < damage_count; ++i) {
+      int can_id = can_ids.at(random(can_ids.size()));
+      can_goods[can_id] = top + 1 + random(qMax(1, good_ids.size()));
+    }
+  }
+
+  // The twins come after the dates they repeat, so a reader keeps the
+  // originals and drops the cans moved to the twins.
+  if((damage & DuplicateDates) && !can_ids.isEmpty()) {
+    int top = date_ids.isEmpty() ? 0 : date_ids.last();
+    QHash<int, int> twin_ids; // <DateId, TwinDateId>
+
+    for(int i = 0; i < damage_count; ++i) {
+      int can_id = can_ids.at(random(can_ids.size()));
+      int date_id = inventory.canDateIds().value(can_id);
+      int twin_id = twin_ids.value(date_id);
+
+      if(!twin_id) {
+        twin_id = ++top;
+        twin_ids.insert(date_id, twin_id);
+        dates.insert(twin_id, dates.value(date_id));
+        date_ids.append(twin_id);
+      }
+
+      can_dates[can_id] = twin_id;
+    }
+  }
+
+  // v1 files were indented, with every number written as a string.
+  JsonWriter writer(version == 1 ? JsonWriter::Indented
+                                 : JsonWriter::Compact);
+
+  auto WriteGoods = [&]() {
+    writer.name("goods");
+
+    if(version == 1)
+      writer.beginObject();
+    else
+      writer.beginArray();
+
+    for(int i = 0; i < good_ids.size(); ++i) {
+      int good_id = good_ids.at(i);
+
+      if(version == 1) {
+        writer.name(QString::number(good_id));
+      }
+      else {
+        writer.beginArray();
+        writer.value(good_id);
+      }
+
+      writer.value(inventory.goods().value(good_id));
+
+      if(version != 1)
+        writer.endArray();
+    }
+
+    if(version == 1)
+      writer.endObject();
+    else
+      writer.endArray();
+  };
+
+  auto WriteDates = [&]() {
+    writer.name("dates");
+
+    if(version == 1)
+      writer.beginObject();
+    else
+      writer.beginArray();
+
+    for(int i = 0; i < date_ids.size(); ++i) {
+      int date_id = date_ids.at(i);
+      qint64 date = dates.value(date_id);
+
+      if(version == 1) {
+        writer.name(QString::number(date_id));
+        writer.value(QString::number(date));
+      }
+      else {
+        writer.beginArray();
+        writer.value(date_id);
+        writer.value(date);
+        writer.endArray();
+      }
+    }
+
+    if(version == 1)
+      writer.endObject();
+    else
+      writer.endArray();
+  };
+
+  auto WriteCans = [&]() {
+    writer.name("cans");
+
+    if(version == 1)
+      writer.beginObject();
+    else
+      writer.beginArray();
+
+    for(int i = 0; i < can_ids.size(); ++i) {
+      int can_id = can_ids.at(i);
+
+      if(version == 1) {
+        writer.name(QString::number(can_id));
+        writer.beginArray();
+        writer.value(QString::number(can_goods.value(can_id)));
+        writer.value(QString::number(can_dates.value(can_id)));
+      }
+      else {
+        writer.beginArray();
+        writer.value(can_id);
+        writer.value(can_goods.value(can_id));
+        writer.value(can_dates.value(can_id));
+
+        int quantity = can_quantities.value(can_id, 1);
+
+        if(version >= 3 && quantity > 1)
+          writer.value(quantity);
+      }
+
+      writer.endArray();
+    }
+
+    if(version == 1)
+      writer.endObject();
+    else
+      writer.endArray();
+  };
+
+  writer.beginObject();
+
+  // v1 files had no version, and their keys were sorted.
+  if(version == 1) {
+    WriteCans();
+    WriteDates();
+    WriteGoods();
+  }
+  else {
+    writer.name("version");
+    writer.value(version);
+
+    WriteGoods();
+    WriteDates();
+    WriteCans();
+  }
+
+  writer.endObject();
+
+  return writer.data();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns a distinct good name for every index >= 0, such as "Beans" or
+/// "Smoked Diced Peaches". Names are letters and spaces only, as the window
+/// requires.
+///////////////////////////////////////////////////////////////////////////////
+QString InventoryGenerator::GoodName(int index)
+{
+  static const char* const Nouns[] = {
+    "Apricots", "Artichokes", "Beans", "Beets", "Carrots", "Cherries",
+    "Chickpeas", "Chili", "Corn", "Crab", "Lentils", "Mushrooms", "Olives",
+    "Peaches", "Pears", "Peas", "Pineapple", "Potatoes", "Pumpkin",
+    "Salmon", "Sardines", "Soup", "Spinach", "Tomatoes", "Tuna", "Yams"
+  };
+
+  static const char* const Adjectives[] = {
+    "Baked", "Black", "Chunky", "Creamy", "Crushed", "Diced", "Golden",
+    "Green", "Organic", "Pickled", "Red", "Roasted", "Sliced", "Smoked",
+    "Spicy", "Sweet", "White", "Whole", "Wild"
+  };
+
+  const int noun_count = sizeof(Nouns) / sizeof(Nouns[0]);
+  const int adjective_count = sizeof(Adjectives) / sizeof(Adjectives[0]);
+
+  QString name = Nouns[index % noun_count];
+  index /= noun_count;
+
+  // Bijective numbering, so every index gets its own run of adjectives.
+  while(index > 0) {
+    --index;
+    name.prepend(QString(Adjectives[index % adjective_count]) + " ");
+    index /= adjective_count;
+  }
+
+  return name;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// Returns a pseudo-random number in [0, bound).
+///////////////////////////////////////////////////////////////////////////////
+int InventoryGenerator::random(int bound)
+{
+  state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+  return static_cast<int>((state_ >> 33) % static_cast<quint64>(bound));
+}
+
+} // namespace jccu
@@ -0,0 +1,73 @@
+#ifndef JCCU_TOOLS_INVENTORY_GENERATOR_H
+#define JCCU_TOOLS_INVENTORY_GENERATOR_H
+
+///////////////////////////////////////////////////////////////////////////////
+/// Includes
+///////////////////////////////////////////////////////////////////////////////
+#include <stdint.h>
+#include <QByteArray>
+#include <QString>
+
+namespace jccu
+{
+
+class GoodManager;
+class DateManager;
+class CanManager;
+class Inventory;
+
+///////////////////////////////////////////////////////////////////////////////
+/// Generates synthetic inventories for load and save tests.
+/// Goods are picked with a zipf-like skew, so a few goods account for most
+/// cans, and expiration dates cluster around a number of days (as they do
+/// when cans are bought in batches). The same seed and settings always give
+/// the same inventory and the same file.
+///////////////////////////////////////////////////////////////////////////////
+class InventoryGenerator
+{
+  public:
+    enum Damage {
+      NoDamage = 0,
+      DanglingGoods = 1 << 0,  // Cans refer to goods that don't exist.
+      DuplicateDates = 1 << 1  // Dates repeat under a second id.
+    };
+
+    explicit InventoryGenerator(quint32 seed = 1);
+    ~InventoryGenerator();
+
+    void setCanCount(int can_count);
+    void setGoodCount(int good_count);
+    void setGoodSkew(double good_skew);
+    void setFirstDay(int64_t first_day);
+    void setDaySpread(int day_spread);
+    void setDateClusters(int date_clusters);
+    void setLotPercent(int lot_percent);
+
+    void generate(GoodManager* good_manager,
+                  DateManager* date_manager,
+                  CanManager* can_manager);
+    QByteArray json(const Inventory& inventory, int version, int damage);
+
+    static QString GoodName(int index);
+
+    static const int64_t DefaultFirstDay = 2460311; // 2024-01-01, Julian.
+
+  private:
+    InventoryGenerator(const InventoryGenerator&);
+    InventoryGenerator& operator=(const InventoryGenerator&);
+
+    int random(int bound);
+
+    quint64 state_;
+    int can_count_;
+    int good_count_;      // Zero means one good per hundred cans.
+    double good_skew_;    // Zero means every good is as likely.
+    int64_t first_day_;   // Julian day.
+    int day_spread_;
+    int date_clusters_;   // Zero means dates are spread evenly.
+    int lot_percent_;     // Share of cans that are lots of 2 to 24.
+};
+
+} // namespace jccu
+
+#endif // JCCU_TOOLS_INVENTORY_GENERATOR_H